@@ -0,0 +1,351 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/interrupt.h>
+
+#include "c_ADC.h"
+
+#define MODE_IDLE   0
+#define MODE_SINGLE 1
+#define MODE_SCAN   2
+#define MODE_STREAM 3
+
+#if defined(ADTS3)
+#define ADTS_MASK 0x0F
+#else
+#define ADTS_MASK 0x07
+#endif
+#define ADTS_FREE_RUNNING 0
+#define ADTS_TIMER1_COMPB ((1 << ADTS2) | (1 << ADTS0))
+
+static volatile uint8_t  _mode;
+static uint8_t           _reference = ADC_REF_VCC;
+static ADCCallback       _done;
+
+// scan state
+static ADCScanCallback   _scanDone;
+static uint8_t           _channels[ADC_MAX_CHANNELS];
+static uint16_t          _values  [ADC_MAX_CHANNELS];
+static uint8_t           _count;
+static uint8_t           _index;
+static uint8_t           _shift;   // oversampling bits
+static uint8_t           _samples; // conversions per channel
+static uint8_t           _left;    // conversions left for the current channel
+static uint16_t          _sum;
+static uint8_t           _free;    // no trigger: restart at once
+static volatile uint16_t _scans;
+
+// stream state
+static uint16_t*         _buffers[2];
+static uint16_t*         _write;   // next sample
+static uint16_t*         _end;
+static uint8_t           _length;  // samples per buffer
+static uint8_t           _current; // buffer being filled
+static volatile uint8_t  _full[2]; // waiting for ADC_release()
+static uint16_t          _seq [2];
+static uint16_t          _produced;
+
+static inline void select(uint8_t channel)
+{
+	ADMUX = (uint8_t) (_reference | (channel & 0x1F));
+#if defined(MUX5)
+	if (channel & 0x20)
+		ADCSRB |= 1 << MUX5;
+	else
+		ADCSRB &= (uint8_t) ~(1 << MUX5);
+#endif
+}
+
+static inline void convert(void)
+{
+	ADCSRA |= 1 << ADSC;
+}
+
+void ADC_begin(uint8_t prescaler, uint8_t reference)
+{
+	ADC_stop();
+	_reference = reference;
+	ADCSRA = (uint8_t) ((1 << ADEN) | (1 << ADIF) | (prescaler & 7));
+}
+
+void ADC_end(void)
+{
+	ADC_stop();
+	ADCSRA = 0;
+}
+
+// analog pin number (A0 or 0) to channel code, as done by analogRead()
+uint8_t ADC_channel(uint8_t pin)
+{
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+	if (pin >= 54) pin -= 54;
+#elif defined(__AVR_ATmega32U4__)
+	if (pin >= 18) pin -= 18;
+#else
+	if (pin >= 14) pin -= 14;
+#endif
+#if defined(analogPinToChannel)
+	pin = analogPinToChannel(pin);
+#endif
+	return (uint8_t) (((pin & 0x08) << 2) | (pin & 0x07));
+}
+
+uint8_t ADC_busy(void)
+{
+	return _mode != MODE_IDLE;
+}
+
+uint8_t ADC_start(uint8_t channel, ADCCallback done)
+{
+	uint8_t sreg = SREG;
+	cli();
+	if (_mode != MODE_IDLE)
+	{
+		SREG = sreg;
+		return 0;
+	}
+	_mode = MODE_SINGLE;
+	SREG = sreg;
+
+	_done = done;
+	select(channel);
+	ADCSRA |= (1 << ADIE) | (1 << ADSC);
+	return 1;
+}
+
+static void trigger(uint16_t rate);
+
+void ADC_scan(const uint8_t* channels, uint8_t count, uint8_t oversampling,
+              uint16_t rate, ADCScanCallback done)
+{
+	ADC_stop();
+	if (count == 0)
+		return;
+	if (count > ADC_MAX_CHANNELS)
+		count = ADC_MAX_CHANNELS;
+	if (oversampling > 3)
+		oversampling = 3;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		_channels[i] = channels[i];
+		_values[i] = 0;
+	}
+	_count    = count;
+	_index    = 0;
+	_shift    = oversampling;
+	_samples  = (uint8_t) (1 << (2 * oversampling));
+	_left     = _samples;
+	_sum      = 0;
+	_scanDone = done;
+	_free     = rate == 0;
+	_mode     = MODE_SCAN;
+	select(_channels[0]);
+
+	if (_free)
+		ADCSRA |= (1 << ADIE) | (1 << ADSC);
+	else
+		trigger(rate);
+}
+
+// Timer1 in CTC mode, compare B at TOP triggers a conversion rate times a
+// second; the fastest clock still fitting the period is picked
+static void trigger(uint16_t rate)
+{
+	uint32_t ticks = F_CPU / rate;
+	uint8_t cs = 1 << CS10;
+	if (ticks > 0x10000)
+	{
+		ticks /= 8;
+		cs = 1 << CS11;
+	}
+	if (ticks > 0x10000)
+	{
+		ticks /= 8;
+		cs = (1 << CS11) | (1 << CS10);
+	}
+	if (ticks > 0x10000)
+	{
+		ticks /= 4;
+		cs = 1 << CS12;
+	}
+	if (ticks > 0x10000)
+		ticks = 0x10000;
+
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCNT1  = 0;
+	OCR1A  = (uint16_t) (ticks - 1);
+	OCR1B  = (uint16_t) (ticks - 1);
+	TIFR1  = 1 << OCF1B;
+	ADCSRB = (uint8_t) ((ADCSRB & ~ADTS_MASK) | ADTS_TIMER1_COMPB);
+	ADCSRA |= (1 << ADATE) | (1 << ADIE);
+	TCCR1B = (uint8_t) ((1 << WGM12) | cs);
+}
+
+// continuous conversions of a channel into two buffers of length samples,
+// rate times a second or, if rate is 0, as fast as the ADC clock allows
+// (free running mode); when a buffer is full, the other one is filled
+// while the program processes it, unless it has not been released yet,
+// in which case the samples are dropped (the sequence number still counts
+// them)
+void ADC_stream(uint8_t channel, uint16_t rate, uint16_t* a, uint16_t* b, uint8_t length)
+{
+	ADC_stop();
+	if (length == 0)
+		return;
+
+	_buffers[0] = a;
+	_buffers[1] = b;
+	_length   = length;
+	_current  = 0;
+	_full[0]  = 0;
+	_full[1]  = 0;
+	_produced = 0;
+	_write    = a;
+	_end      = a + length;
+	_free     = rate == 0;
+	_mode     = MODE_STREAM;
+	select(channel);
+
+	if (_free)
+	{
+		ADCSRB = (uint8_t) ((ADCSRB & ~ADTS_MASK) | ADTS_FREE_RUNNING);
+		ADCSRA |= (1 << ADATE) | (1 << ADIE) | (1 << ADSC);
+	}
+	else
+		trigger(rate);
+}
+
+// full buffer of the stream (and its sequence number), or NULL
+uint16_t* ADC_next(uint16_t* sequence)
+{
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		if (!_full[i])
+			continue;
+		if (sequence)
+			*sequence = _seq[i];
+		return _buffers[i];
+	}
+	return 0;
+}
+
+// hand a buffer returned by ADC_next() back to the stream
+void ADC_release(uint16_t* buffer)
+{
+	if (buffer == _buffers[0])
+		_full[0] = 0;
+	else if (buffer == _buffers[1])
+		_full[1] = 0;
+}
+
+void ADC_stop(void)
+{
+	if ((_mode == MODE_SCAN || _mode == MODE_STREAM) && !_free)
+		TCCR1B = 0;
+	ADCSRA &= (uint8_t) ~((1 << ADATE) | (1 << ADIE));
+	while (ADCSRA & (1 << ADSC)); // let a started conversion complete
+	ADCSRA |= 1 << ADIF;
+	_mode = MODE_IDLE;
+}
+
+// latest value of the index-th channel of the scan
+uint16_t ADC_read(uint8_t index)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t r = index < ADC_MAX_CHANNELS ? _values[index] : 0;
+	SREG = sreg;
+	return r;
+}
+
+// number of completed scans
+uint16_t ADC_scans(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t r = _scans;
+	SREG = sreg;
+	return r;
+}
+
+ISR(ADC_vect)
+{
+	uint16_t value = ADC;
+
+	if (_mode == MODE_SINGLE)
+	{
+		ADCSRA &= (uint8_t) ~(1 << ADIE);
+		_mode = MODE_IDLE;
+		if (_done)
+			_done(value);
+		return;
+	}
+
+	if (_mode == MODE_STREAM)
+	{
+		if (!_free)
+			TIFR1 = 1 << OCF1B; // re-arm the trigger
+		*_write++ = value;
+		if (_write != _end)
+			return;
+
+		uint8_t c = _current;
+		_seq[c] = _produced++;
+		if (!_full[c ^ 1])
+		{
+			_full[c] = 1;
+			_current = c = c ^ 1;
+		}
+		_write = _buffers[c];
+		_end   = _write + _length;
+		return;
+	}
+
+	if (_mode != MODE_SCAN)
+		return;
+
+	_sum += value;
+	if (--_left)
+	{
+		convert(); // same channel again
+		return;
+	}
+	_values[_index] = _sum >> _shift;
+	_sum  = 0;
+	_left = _samples;
+
+	if (++_index < _count)
+	{
+		select(_channels[_index]);
+		convert();
+		return;
+	}
+
+	// scan complete: arm the next one
+	_index = 0;
+	_scans++;
+	select(_channels[0]);
+	if (_free)
+		convert();
+	else
+		TIFR1 = 1 << OCF1B; // the trigger is the rising edge of this flag
+	if (_scanDone)
+		_scanDone(_values);
+}
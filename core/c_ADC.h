@@ -0,0 +1,78 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef ADC_H
+#define ADC_H
+
+#include <Arduino.h>
+
+// Interrupt-driven ADC driver
+//
+// Conversions are started and return at once; results are delivered from
+// the ADC interrupt. A scan converts a list of channels each time Timer1
+// (compare B, used as the ADC auto trigger) fires, or back to back if the
+// rate is 0. A stream does the same with a single channel and stores the
+// samples into a pair of buffers. Timer1 is therefore not available for
+// analogWrite() while a timed scan or stream is running.
+//
+// Channels are MUX codes: bits 4:0 go to ADMUX, bit 5 to MUX5 (where it
+// exists); ADC_channel() converts an analog pin (A0, 0...) to its code.
+
+#define ADC_MAX_CHANNELS 8
+
+// ADC clock is F_CPU divided by 2^prescaler; a conversion takes 13 ADC
+// clocks, full precision needs a 50-200 kHz ADC clock (prescaler 7 at 16 MHz)
+#define ADC_PRESCALER_2   1
+#define ADC_PRESCALER_4   2
+#define ADC_PRESCALER_8   3
+#define ADC_PRESCALER_16  4
+#define ADC_PRESCALER_32  5
+#define ADC_PRESCALER_64  6
+#define ADC_PRESCALER_128 7
+
+// voltage references (same as analogReference())
+#define ADC_REF_EXTERNAL 0x00
+#define ADC_REF_VCC      0x40
+#define ADC_REF_INTERNAL 0xC0
+
+typedef void (*ADCCallback)    (uint16_t value);
+typedef void (*ADCScanCallback)(const uint16_t* values);
+
+void     ADC_begin  (uint8_t prescaler, uint8_t reference);
+void     ADC_end    (void);
+uint8_t  ADC_channel(uint8_t pin);
+uint8_t  ADC_busy   (void);
+
+// single conversion; returns 0 if the ADC is busy
+uint8_t  ADC_start  (uint8_t channel, ADCCallback done);
+
+// repeated scan of up to ADC_MAX_CHANNELS channels, rate times a second
+// (0 for back to back scans); each channel is converted 4^oversampling
+// times and decimated to 10 + oversampling bits (oversampling <= 3)
+void     ADC_scan   (const uint8_t* channels, uint8_t count, uint8_t oversampling,
+                     uint16_t rate, ADCScanCallback done);
+void     ADC_stop   (void);
+uint16_t ADC_read   (uint8_t index);
+uint16_t ADC_scans  (void);
+
+// continuous sampling of one channel into two alternating buffers
+void      ADC_stream (uint8_t channel, uint16_t rate, uint16_t* a, uint16_t* b, uint8_t length);
+uint16_t* ADC_next   (uint16_t* sequence);
+void      ADC_release(uint16_t* buffer);
+
+#endif
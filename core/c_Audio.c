@@ -0,0 +1,170 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+
+#include "c_USB.h"
+
+#if defined(USBCON)
+#ifdef AUDIO_ENABLED
+
+// USB Audio Class 1.0 microphone
+//
+// The streaming interface has an empty alternate setting 0 and, in
+// alternate setting 1, an asynchronous isochronous IN endpoint. On each
+// start of frame, the samples written since the last one are moved to the
+// endpoint: AUDIO_RATE / 1000 of them, one more when they pile up (the
+// sample clock is not the host's), fewer when there are not enough.
+
+#define FRAME_SAMPLES (AUDIO_RATE / 1000)
+#define MAX_SAMPLES   (FRAME_SAMPLES + 1)
+#define TARGET        (2 * FRAME_SAMPLES) // samples kept ready to send
+
+#define RING_SIZE 64 // samples, power of 2
+#define RING_MASK (RING_SIZE - 1)
+
+#define AUDIO_CS_INTERFACE 0x24
+#define AUDIO_CS_ENDPOINT  0x25
+
+static const u8 _audioInterface[] PROGMEM =
+{
+	// interface association
+	8, 11, AUDIO_AC_INTERFACE, 2, 0x01, 0x01, 0x00, 0,
+
+	// audio control interface, no endpoint
+	9, USB_INTERFACE_DESCRIPTOR_TYPE, AUDIO_AC_INTERFACE, 0, 0, 0x01, 0x01, 0x00, 0,
+	9, AUDIO_CS_INTERFACE, 0x01, TOBYTES(0x0100), TOBYTES(9 + 12 + 9), 1, AUDIO_STREAM_INTERFACE, // header
+	12, AUDIO_CS_INTERFACE, 0x02, 1, TOBYTES(0x0201), 0, 1, TOBYTES(0x0000), 0, 0, // input terminal 1: microphone
+	9, AUDIO_CS_INTERFACE, 0x03, 2, TOBYTES(0x0101), 0, 1, 0,                       // output terminal 2: USB streaming
+
+	// audio streaming interface, alternate setting 0: no bandwidth
+	9, USB_INTERFACE_DESCRIPTOR_TYPE, AUDIO_STREAM_INTERFACE, 0, 0, 0x01, 0x02, 0x00, 0,
+
+	// alternate setting 1: 16-bit mono PCM
+	9, USB_INTERFACE_DESCRIPTOR_TYPE, AUDIO_STREAM_INTERFACE, 1, 1, 0x01, 0x02, 0x00, 0,
+	7, AUDIO_CS_INTERFACE, 0x01, 2, 1, TOBYTES(0x0001),                 // general: from terminal 2, PCM
+	11, AUDIO_CS_INTERFACE, 0x02, 1, 1, 2, 16, 1,                       // format type I, one rate
+	(AUDIO_RATE & 0xFF), ((AUDIO_RATE >> 8) & 0xFF), ((AUDIO_RATE >> 16) & 0xFF),
+
+	// asynchronous isochronous endpoint, audio class layout (9 bytes)
+	9, USB_ENDPOINT_DESCRIPTOR_TYPE, USB_ENDPOINT_IN(AUDIO_ENDPOINT_ISO), 0x05, TOBYTES(2 * MAX_SAMPLES), 1, 0, 0,
+	7, AUDIO_CS_ENDPOINT, 0x01, 0x00, 0, TOBYTES(0),
+};
+
+static int16_t          _ring[RING_SIZE];
+static volatile uint8_t _head; // moved by Audio_write()
+static volatile uint8_t _tail; // moved by Audio_SOF()
+static volatile uint8_t _alternate;
+
+int Audio_GetInterface(USBClass* c, u8* interfaceNum)
+{
+	(void) c;
+	interfaceNum[0] += 2; // uses 2
+	return USB_SendControl(TRANSFER_PGM, _audioInterface, sizeof(_audioInterface));
+}
+
+// standard GET_INTERFACE/SET_INTERFACE on the streaming interface; there is
+// no class request (no control on the terminals or the endpoint)
+bool Audio_Setup(USBClass* c, Setup* setup)
+{
+	(void) c;
+	if ((setup->bmRequestType & REQUEST_TYPE) != REQUEST_STANDARD
+	 || (u8) setup->wIndex != AUDIO_STREAM_INTERFACE)
+		return false;
+
+	if (setup->bRequest == GET_INTERFACE)
+	{
+		u8 alternate = _alternate;
+		USB_SendControl(0, &alternate, 1);
+		return true;
+	}
+	if (setup->bRequest == SET_INTERFACE && setup->wValueL <= 1)
+	{
+		// start with the samples to come
+		_tail = _head;
+		_alternate = setup->wValueL;
+		return true;
+	}
+	return false;
+}
+
+// called on each start of frame
+void Audio_SOF(USBClass* c)
+{
+	(void) c;
+	if (!_alternate || !USBGetConfiguration())
+		return;
+
+	UENUM = AUDIO_TX;
+	if (!(UEINTX & (1<<RWAL))) // both banks are waiting for the host
+		return;
+
+	uint8_t t = _tail;
+	uint8_t available = (uint8_t) (_head - t) & RING_MASK;
+	uint8_t n = available > TARGET ? MAX_SAMPLES : FRAME_SAMPLES;
+	if (n > available)
+		n = available;
+	while (n--)
+	{
+		int16_t sample = _ring[t];
+		UEDATX = (u8) sample;
+		UEDATX = (u8) ((uint16_t) sample >> 8);
+		t = (t + 1) & RING_MASK;
+	}
+	_tail = t;
+
+	// send the bank, even empty
+	UEINTX = 0x3A; // same as ReleaseTX()
+}
+
+// whether the host is recording
+bool Audio_streaming(void)
+{
+	return _alternate != 0;
+}
+
+// number of samples Audio_write() can take
+int Audio_space(void)
+{
+	return (uint8_t) (_tail - _head - 1) & RING_MASK;
+}
+
+// queues samples for the next frames; returns the number of samples
+// queued, less than count if the ring is full or the host is not recording
+int Audio_write(const int16_t* samples, int count)
+{
+	if (!_alternate)
+		return 0;
+
+	int space = Audio_space();
+	if (count > space)
+		count = space;
+
+	uint8_t h = _head;
+	for (int i = 0; i < count; i++)
+	{
+		_ring[h] = samples[i];
+		h = (h + 1) & RING_MASK;
+	}
+	_head = h;
+	return count;
+}
+
+#endif
+#endif /* if defined(USBCON) */
@@ -0,0 +1,186 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/interrupt.h>
+
+#include "c_BAM.h"
+
+#if defined(TCCR3A)
+#define BAM_TCCRA  TCCR3A
+#define BAM_TCCRB  TCCR3B
+#define BAM_TCNT   TCNT3
+#define BAM_OCR    OCR3A
+#define BAM_TIMSK  TIMSK3
+#define BAM_TIFR   TIFR3
+#define BAM_OCIE   OCIE3A
+#define BAM_OCF    OCF3A
+#define BAM_CTC    (1 << WGM32)
+#define BAM_CLOCK  (1 << CS31) // F_CPU / 8
+#define BAM_vect   TIMER3_COMPA_vect
+#else
+#define BAM_TCCRA  TCCR1A
+#define BAM_TCCRB  TCCR1B
+#define BAM_TCNT   TCNT1
+#define BAM_OCR    OCR1A
+#define BAM_TIMSK  TIMSK1
+#define BAM_TIFR   TIFR1
+#define BAM_OCIE   OCIE1A
+#define BAM_OCF    OCF1A
+#define BAM_CTC    (1 << WGM12)
+#define BAM_CLOCK  (1 << CS11) // F_CPU / 8
+#define BAM_vect   TIMER1_COMPA_vect
+#endif
+
+typedef uint8_t Masks[8][BAM_MAX_PORTS]; // pins to switch on, per bit and port
+
+static volatile uint8_t* _ports[BAM_MAX_PORTS];
+static uint8_t           _portMask[BAM_MAX_PORTS]; // all pins driven on the port
+static uint8_t           _nports;
+
+static uint8_t _channelPort[BAM_MAX_CHANNELS];
+static uint8_t _channelMask[BAM_MAX_CHANNELS];
+static uint8_t _levels     [BAM_MAX_CHANNELS];
+static uint8_t _nchannels;
+
+// the interrupt reads the front masks while BAM_update() fills the back ones
+static Masks            _masks[2];
+static Masks* volatile  _front = &_masks[0];
+static Masks* volatile  _back  = &_masks[1];
+static volatile uint8_t _swap;
+static uint8_t          _bit;
+
+void BAM_begin(void)
+{
+	_bit = 0;
+	BAM_TCCRA = 0;
+	BAM_TCCRB = BAM_CTC | BAM_CLOCK;
+	BAM_OCR   = BAM_LSB_TICKS - 1;
+	BAM_TCNT  = 0;
+	BAM_TIFR  = 1 << BAM_OCF;
+	BAM_TIMSK |= 1 << BAM_OCIE;
+}
+
+void BAM_end(void)
+{
+	BAM_TIMSK &= (uint8_t) ~(1 << BAM_OCIE);
+	for (uint8_t p = 0; p < _nports; p++)
+	{
+		uint8_t sreg = SREG;
+		cli();
+		*_ports[p] &= (uint8_t) ~_portMask[p];
+		SREG = sreg;
+	}
+}
+
+// returns the channel number of the pin, or -1 if there is no room left
+int8_t BAM_attach(uint8_t pin)
+{
+	if (_nchannels >= BAM_MAX_CHANNELS)
+		return -1;
+
+	volatile uint8_t* port = portOutputRegister(digitalPinToPort(pin));
+	uint8_t p = 0;
+	while (p < _nports && _ports[p] != port)
+		p++;
+	if (p == _nports)
+	{
+		if (_nports >= BAM_MAX_PORTS)
+			return -1;
+
+		// the interrupt walks _ports up to _nports: publish both at once
+		uint8_t sreg = SREG;
+		cli();
+		_ports[p] = port;
+		_nports = p + 1;
+		SREG = sreg;
+	}
+
+	uint8_t mask = digitalPinToBitMask(pin);
+	digitalWrite(pin, LOW);
+	pinMode(pin, OUTPUT);
+
+	// the interrupt only reads _portMask; a single byte store is atomic
+	_portMask[p] |= mask;
+
+	uint8_t c = _nchannels++;
+	_channelPort[c] = p;
+	_channelMask[c] = mask;
+	_levels[c] = 0;
+	return (int8_t) c;
+}
+
+// takes effect on the next BAM_update()
+void BAM_set(uint8_t channel, uint8_t level)
+{
+	if (channel < _nchannels)
+		_levels[channel] = level;
+}
+
+// rebuild the port masks from the levels and hand them over to the
+// interrupt at the start of the next cycle, so a cycle never mixes the old
+// and new levels; only waits if the previous update is still pending
+void BAM_update(void)
+{
+	while (_swap);
+
+	Masks* m = _back;
+	for (uint8_t b = 0; b < 8; b++)
+		for (uint8_t p = 0; p < BAM_MAX_PORTS; p++)
+			(*m)[b][p] = 0;
+
+	for (uint8_t c = 0; c < _nchannels; c++)
+	{
+		uint8_t level = _levels[c];
+		uint8_t p     = _channelPort[c];
+		uint8_t mask  = _channelMask[c];
+		for (uint8_t b = 0; b < 8; b++, level >>= 1)
+			if (level & 1)
+				(*m)[b][p] |= mask;
+	}
+
+	_swap = true;
+	if (!(BAM_TIMSK & (1 << BAM_OCIE)))
+	{
+		// not running: nothing to synchronize with
+		_back  = _front;
+		_front = m;
+		_swap  = false;
+	}
+}
+
+// start of the period of bit _bit: lasts BAM_LSB_TICKS << _bit
+ISR(BAM_vect)
+{
+	if (_bit == 0 && _swap)
+	{
+		Masks* m = _front;
+		_front = _back;
+		_back  = m;
+		_swap  = false;
+	}
+
+	const uint8_t* on = (*_front)[_bit];
+	for (uint8_t p = 0; p < _nports; p++)
+	{
+		volatile uint8_t* port = _ports[p];
+		*port = (uint8_t) ((*port & ~_portMask[p]) | on[p]);
+	}
+
+	BAM_OCR = (uint16_t) ((BAM_LSB_TICKS << _bit) - 1);
+	_bit = (_bit + 1) & 7;
+}
@@ -0,0 +1,50 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef BAM_H
+#define BAM_H
+
+#include <Arduino.h>
+
+// Bit angle modulation (binary code modulation) on any digital pin
+//
+// An 8-bit cycle is split into 8 periods lasting 1, 2, 4 ... 128 times
+// BAM_LSB_TICKS; at the start of period n, every pin whose level has bit n
+// set is switched on, the others off. A single timer interrupt per period
+// writes whole ports from precomputed masks, so its cost depends on the
+// number of ports in use and not on the number of channels.
+//
+// Timer3 is used when available (Leonardo, Mega), Timer1 otherwise, which
+// disables analogWrite() on the pins of that timer.
+
+#define BAM_MAX_CHANNELS 32
+#define BAM_MAX_PORTS    4
+
+// length of the least significant bit period, in timer ticks (0.5 us at
+// 16 MHz); the default gives a 2.04 ms cycle, i.e. about 245 Hz
+#ifndef BAM_LSB_TICKS
+#define BAM_LSB_TICKS 16
+#endif
+
+void   BAM_begin (void);
+void   BAM_end   (void);
+int8_t BAM_attach(uint8_t pin);
+void   BAM_set   (uint8_t channel, uint8_t level);
+void   BAM_update(void);
+
+#endif
@@ -18,37 +18,14 @@
 
 #include <avr/wdt.h>
 
+#include <avr/pgmspace.h>
+
 #if defined(USBCON)
 #ifdef CDC_ENABLED
 
-#if (RAMEND < 1000)
-#define SERIAL_BUFFER_SIZE 16
-#else
-#define SERIAL_BUFFER_SIZE 64
-#endif
-
-typedef struct
-{
-	unsigned char buffer[SERIAL_BUFFER_SIZE];
-	volatile int head;
-	volatile int tail;
-} ring_buffer;
-
-ring_buffer cdc_rx_buffer = { { 0 }, 0, 0};
-
-typedef struct
-{
-	u32	dwDTERate;
-	u8	bCharFormat;
-	u8 	bParityType;
-	u8 	bDataBits;
-	u8	lineState;
-} LineInfo;
-
-static volatile LineInfo _usbLineInfo = { 57600, 0x00, 0x00, 0x00, 0x00 };
-
 #define WEAK __attribute__ ((weak))
 
+// descriptors of Serial_port, renumbered for the other ports
 static const CDCDescriptor _cdcInterface PROGMEM =
 {
 	D_IAD(0,2,CDC_COMMUNICATION_INTERFACE_CLASS,CDC_ABSTRACT_CONTROL_MODEL,1),
@@ -67,14 +44,50 @@ static const CDCDescriptor _cdcInterface PROGMEM =
 	D_ENDPOINT(USB_ENDPOINT_IN (CDC_ENDPOINT_IN ),USB_ENDPOINT_TYPE_BULK,0x40,0)
 };
 
-int WEAK CDC_GetInterface(u8* interfaceNum)
+static const USBEndpoint _cdcEndpoints[] PROGMEM =
+{
+	{ EP_TYPE_INTERRUPT_IN, 0x10 }, // CDC_ENDPOINT_ACM
+	{ EP_TYPE_BULK_OUT,     0x40 }, // CDC_ENDPOINT_OUT
+	{ EP_TYPE_BULK_IN,      0x40 }, // CDC_ENDPOINT_IN
+};
+
+static void CDC_SOF(USBClass* c)
 {
+	CDCPort* port = (CDCPort*) c;
+	USB_Flush(CDC_PORT_TX(port));            // Send a tx frame if found
+	while (USB_Available(CDC_PORT_RX(port))) // Handle received bytes (if any)
+		CDC_accept(port);
+}
+
+#define CDC_CLASS     { 2, 3, _cdcEndpoints, CDC_GetInterface, 0, CDC_Setup, CDC_SOF, 0, 0, 0 }
+#define CDC_LINE_INFO { 57600, 0x00, 0x00, 0x00, 0x00 }
+
+CDCPort Serial_port = { CDC_CLASS, { 0 }, 0, 0, CDC_LINE_INFO };
+
+int WEAK CDC_GetInterface(USBClass* c, u8* interfaceNum)
+{
+	u8 acm = c->firstInterface;
+	u8 ep  = c->firstEndpoint;
+
+	CDCDescriptor d;
+	memcpy_P(&d, &_cdcInterface, sizeof(d));
+	d.iad.firstInterface              = acm;
+	d.cif.number                      = acm;
+	d.callManagement.bDataInterface   = (u8) (acm + 1);
+	d.functionalDescriptor.d0         = acm;
+	d.functionalDescriptor.d1         = (u8) (acm + 1);
+	d.cifin.addr                      = USB_ENDPOINT_IN(ep);
+	d.dif.number                      = (u8) (acm + 1);
+	d.in.addr                         = USB_ENDPOINT_OUT(ep + 1); // in the order of _cdcInterface
+	d.out.addr                        = USB_ENDPOINT_IN (ep + 2);
+
 	interfaceNum[0] += 2;	// uses 2
-	return USB_SendControl(TRANSFER_PGM,&_cdcInterface,sizeof(_cdcInterface));
+	return USB_SendControl(0,&d,sizeof(d));
 }
 
-bool WEAK CDC_Setup(Setup* setup)
+bool WEAK CDC_Setup(USBClass* c, Setup* setup)
 {
+	volatile LineInfo* line = &((CDCPort*) c)->lineInfo;
 	u8 r = setup->bRequest;
 	u8 requestType = setup->bmRequestType;
 
@@ -82,7 +95,7 @@ bool WEAK CDC_Setup(Setup* setup)
 	{
 		if (CDC_GET_LINE_CODING == r)
 		{
-			USB_SendControl(0,(void*)&_usbLineInfo,7);
+			USB_SendControl(0,(void*)line,7);
 			return true;
 		}
 	}
@@ -91,21 +104,21 @@ bool WEAK CDC_Setup(Setup* setup)
 	{
 		if (CDC_SET_LINE_CODING == r)
 		{
-			USB_RecvControl((void*)&_usbLineInfo,7);
+			USB_RecvControl((void*)line,7);
 			return true;
 		}
 
 		if (CDC_SET_CONTROL_LINE_STATE == r)
 		{
-			_usbLineInfo.lineState = setup->wValueL;
+			line->lineState = setup->wValueL;
 
 			// auto-reset into the bootloader is triggered when the port, already
 			// open at 1200 bps, is closed.  this is the signal to start the watchdog
 			// with a relatively long period so it can finish housekeeping tasks
 			// like servicing endpoints before the sketch ends
-			if (1200 == _usbLineInfo.dwDTERate) {
+			if (1200 == line->dwDTERate) {
 				// We check DTR state to determine if host port is open (bit 0 of lineState).
-				if ((_usbLineInfo.lineState & 0x01) == 0) {
+				if ((line->lineState & 0x01) == 0) {
 					*(uint16_t *)0x0800 = 0x7777;
 					wdt_enable(WDTO_120MS);
 				} else {
@@ -125,61 +138,72 @@ bool WEAK CDC_Setup(Setup* setup)
 	return false;
 }
 
+// adds a port after the classes already plugged (see USB_plug())
+bool CDC_begin(CDCPort* port)
+{
+	port->usb      = (USBClass) CDC_CLASS;
+	port->head     = 0;
+	port->tail     = 0;
+	port->lineInfo = (LineInfo) CDC_LINE_INFO;
+	return USB_plug(&port->usb);
+}
 
-int _serialPeek = -1;
-
-void Serial_accept(void)
+void CDC_accept(CDCPort* port)
 {
-	ring_buffer *buffer = &cdc_rx_buffer;
 	int c;
-	USB_Recv(CDC_RX, &c, 1);
-	int i = (unsigned int)(buffer->head+1) % SERIAL_BUFFER_SIZE;
+	USB_Recv(CDC_PORT_RX(port), &c, 1);
+	int i = (unsigned int)(port->head+1) % SERIAL_BUFFER_SIZE;
 
 	// if we should be storing the received character into the location
 	// just before the tail (meaning that the head would advance to the
 	// current location of the tail), we're about to overflow the buffer
 	// and so we don't write the character or advance the head.
-	if (i != buffer->tail)
+	if (i != port->tail)
 	{
-		buffer->buffer[buffer->head] = c;
-		buffer->head = i;
+		port->buffer[port->head] = (unsigned char) c;
+		port->head = i;
 	}
+	else
+		USB_COUNT(CDC_PORT_RX(port), overflows, 1);
 }
 
-int Serial_available(void)
+int CDC_available(CDCPort* port)
 {
-	ring_buffer *buffer = &cdc_rx_buffer;
-	return (unsigned int) (SERIAL_BUFFER_SIZE + buffer->head - buffer->tail) % SERIAL_BUFFER_SIZE;
+	return (unsigned int) (SERIAL_BUFFER_SIZE + port->head - port->tail) % SERIAL_BUFFER_SIZE;
 }
 
-int Serial_peek(void)
+int CDC_peek(CDCPort* port)
 {
-	ring_buffer *buffer = &cdc_rx_buffer;
-	if (buffer->head == buffer->tail)
+	if (port->head == port->tail)
 		return -1;
 	else
-		return buffer->buffer[buffer->tail];
+		return port->buffer[port->tail];
 }
 
-int Serial_read(void)
+int CDC_read(CDCPort* port)
 {
-	ring_buffer *buffer = &cdc_rx_buffer;
 	// if the head isn't ahead of the tail, we don't have any characters
-	if (buffer->head == buffer->tail) {
+	if (port->head == port->tail) {
 		return -1;
 	} else {
-		unsigned char c = buffer->buffer[buffer->tail];
-		buffer->tail = (unsigned int)(buffer->tail + 1) % SERIAL_BUFFER_SIZE;
+		unsigned char c = port->buffer[port->tail];
+		port->tail = (unsigned int)(port->tail + 1) % SERIAL_BUFFER_SIZE;
 		return c;
 	}
 }
 
-void Serial_flush(void)
+// whether the host has opened the port (DTR set)
+bool CDC_connected(CDCPort* port)
 {
-	USB_Flush(CDC_TX);
+	return port->lineInfo.lineState > 0;
 }
 
-size_t Serial_write(uint8_t c)
+void CDC_flush(CDCPort* port)
+{
+	USB_Flush(CDC_PORT_TX(port));
+}
+
+size_t CDC_write(CDCPort* port, const void* data, size_t size)
 {
 	/* only try to send bytes if the high-level CDC connection itself
 	 is open (not just the pipe) - the OS should set lineState when the port
@@ -190,12 +214,12 @@ size_t Serial_write(uint8_t c)
 	// TODO - ZE - check behavior on different OSes and test what happens if an
 	// open connection isn't broken cleanly (cable is yanked out, host dies
 	// or locks up, or host virtual serial port hangs)
-	if (_usbLineInfo.lineState > 0)
+	if (port->lineInfo.lineState > 0)
 	{
-		int r = USB_Send(CDC_TX,&c,1);
+		int r = USB_Send(CDC_PORT_TX(port),data,(int)size);
 		if (r > 0)
 		{
-			return r;
+			return (size_t)r;
 		}
 		else
 		{
@@ -207,5 +231,45 @@ size_t Serial_write(uint8_t c)
 	return 0;
 }
 
+void Serial_accept(void)
+{
+	CDC_accept(&Serial_port);
+}
+
+int Serial_available(void)
+{
+	return CDC_available(&Serial_port);
+}
+
+int Serial_peek(void)
+{
+	return CDC_peek(&Serial_port);
+}
+
+int Serial_read(void)
+{
+	return CDC_read(&Serial_port);
+}
+
+bool Serial_connected(void)
+{
+	return CDC_connected(&Serial_port);
+}
+
+void Serial_flush(void)
+{
+	CDC_flush(&Serial_port);
+}
+
+size_t Serial_write(uint8_t c)
+{
+	return CDC_write(&Serial_port, &c, 1);
+}
+
+size_t Serial_writeBytes(const uint8_t* data, size_t size)
+{
+	return CDC_write(&Serial_port, data, size);
+}
+
 #endif
 #endif /* if defined(USBCON) */
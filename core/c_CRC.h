@@ -0,0 +1,42 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <Arduino.h>
+
+// Table-driven CRCs, the tables being in program memory
+//
+// CRC16 is CRC-16/CCITT-FALSE (polynomial 0x1021, MSB first): start from
+// CRC16_INIT and send the result MSB first. CRC32 is the CRC-32 of
+// Ethernet and zlib (polynomial 0x04C11DB7, LSB first): start from
+// CRC32_INIT and send the complement of the result LSB first.
+//
+// Running the CRC over the data followed by its CRC, sent as above, gives
+// the residue: the data can be checked without knowing where it ends.
+
+#define CRC16_INIT    0xFFFF
+#define CRC16_RESIDUE 0x0000
+#define CRC32_INIT    0xFFFFFFFFUL
+#define CRC32_RESIDUE 0xDEBB20E3UL
+
+uint16_t CRC16(uint16_t crc, const void* data, size_t size);
+uint32_t CRC32(uint32_t crc, const void* data, size_t size);
+
+#endif
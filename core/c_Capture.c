@@ -0,0 +1,284 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "c_Capture.h"
+
+#define PACKET_SIZE 64
+#define PAYLOAD     (PACKET_SIZE - 2)
+#define FLUSH_MS    10 // longest time records wait for a packet to fill up
+
+// 256 bytes, so that the 8-bit indices wrap by themselves
+static uint8_t          _ring[256];
+static volatile uint8_t _head; // moved by the interrupts
+static volatile uint8_t _tail; // moved by Capture_poll()
+
+static volatile uint8_t* _pin0;
+static volatile uint8_t* _pin1;
+static uint8_t           _mask0;
+static uint8_t           _mask1;
+static uint8_t           _two;   // two ports per record
+static volatile uint8_t  _none;  // stands for the second port when unused
+
+static uint8_t           _flags;
+static uint8_t           _last0; // value of the current run
+static uint8_t           _last1;
+static uint8_t           _run;   // timer mode: ticks in the current run
+static uint16_t          _since; // pin change mode: start of the current run
+static uint32_t          _rate;
+
+static volatile uint8_t  _running;
+static volatile uint8_t  _lost;  // records lost since the last packet
+static volatile uint16_t _overflows;
+
+static void stop(void)
+{
+	TIMSK1 &= (uint8_t) ~(1 << OCIE1A);
+	PCICR  &= (uint8_t) ~(1 << PCIE0);
+	_running = 0;
+}
+
+static inline void emit(uint8_t a, uint8_t b, uint8_t run)
+{
+	uint8_t h = _head;
+	uint8_t size = _two ? 3 : 2;
+	if ((uint8_t) (_tail - h - 1) < size)
+	{
+		if (_flags & CAPTURE_ONESHOT)
+		{
+			stop();
+		}
+		else
+		{
+			_lost = 1;
+			_overflows++;
+		}
+		return;
+	}
+	_ring[h++] = a;
+	if (_two)
+		_ring[h++] = b;
+	_ring[h++] = run;
+	_head = h;
+}
+
+void Capture_begin(const uint8_t* ports, const uint8_t* masks, uint8_t count,
+                   uint32_t rate, uint8_t flags)
+{
+	Capture_end();
+	if (count == 0 || rate == 0)
+		return;
+
+	_pin0  = portInputRegister(ports[0]);
+	_mask0 = masks[0];
+	_two   = count > 1;
+	_pin1  = _two ? portInputRegister(ports[1]) : &_none;
+	_mask1 = _two ? masks[1] : 0;
+	_flags = flags;
+	_head  = 0;
+	_tail  = 0;
+	_lost  = 0;
+	_overflows = 0;
+
+	// timer mode: fastest Timer1 clock whose period still fits 16 bits;
+	// pin change mode: slowest clock at least as fast as rate
+	static const uint8_t shifts[] = { 0, 3, 6, 8, 10 }; // prescalers
+	uint8_t i = 0;
+	if (flags & CAPTURE_PINCHANGE)
+		while (i < 4 && (F_CPU >> shifts[i + 1]) >= rate)
+			i++;
+	else
+		while (i < 4 && (F_CPU >> shifts[i]) / rate > 0x10000)
+			i++;
+	uint32_t clock = F_CPU >> shifts[i];
+	uint8_t cs = (uint8_t) (i + 1);
+
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCNT1  = 0;
+	_last0 = *_pin0 & _mask0;
+	_last1 = *_pin1 & _mask1;
+	_run   = 0;
+	_since = 0;
+
+	if (flags & CAPTURE_PINCHANGE)
+	{
+		// Timer1 counts ticks, compare A marks runs of 255 ticks
+		_rate  = clock;
+		OCR1A  = 255;
+		PCIFR  = 1 << PCIF0;
+		PCICR |= 1 << PCIE0;
+		TCCR1B = cs;
+	}
+	else
+	{
+		uint32_t ticks = clock / rate;
+		if (ticks > 0x10000)
+			ticks = 0x10000;
+		_rate  = clock / ticks;
+		OCR1A  = (uint16_t) (ticks - 1);
+		TCCR1B = (uint8_t) ((1 << WGM12) | cs);
+	}
+
+	_running = 1;
+	TIFR1   = 1 << OCF1A;
+	TIMSK1 |= 1 << OCIE1A;
+}
+
+// stop sampling and record the current run
+void Capture_end(void)
+{
+	if (!_running)
+		return;
+	stop();
+	TCCR1B = 0;
+	uint8_t run = _run;
+	if (_flags & CAPTURE_PINCHANGE)
+	{
+		uint16_t elapsed = TCNT1 - _since;
+		run = elapsed > 255 ? 255 : (uint8_t) elapsed;
+	}
+	if (run)
+		emit(_last0, _last1, run);
+}
+
+uint8_t Capture_running(void)
+{
+	return _running;
+}
+
+// actual number of ticks per second
+uint32_t Capture_rate(void)
+{
+	return _rate;
+}
+
+// number of records lost because the ring was full
+uint16_t Capture_overflows(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t r = _overflows;
+	SREG = sreg;
+	return r;
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+	if (_flags & CAPTURE_PINCHANGE)
+	{
+		// no change for 255 ticks
+		emit(_last0, _last1, 255);
+		_since += 255;
+		OCR1A = _since + 255;
+		return;
+	}
+
+	uint8_t a = *_pin0 & _mask0;
+	uint8_t b = *_pin1 & _mask1;
+	if (a == _last0 && b == _last1 && _run != 255)
+	{
+		_run++;
+		return;
+	}
+	if (_run)
+		emit(_last0, _last1, _run);
+	_last0 = a;
+	_last1 = b;
+	_run   = 1;
+}
+
+ISR(PCINT0_vect)
+{
+	uint16_t now = TCNT1;
+	uint8_t a = *_pin0 & _mask0;
+	uint8_t b = *_pin1 & _mask1;
+	if (a == _last0 && b == _last1)
+		return; // a pin that is not recorded
+
+	// compare A may be pending if this interrupt came first
+	uint16_t elapsed = now - _since;
+	while (elapsed > 255)
+	{
+		emit(_last0, _last1, 255);
+		elapsed -= 255;
+	}
+	if (elapsed)
+		emit(_last0, _last1, (uint8_t) elapsed);
+	_last0 = a;
+	_last1 = b;
+	_since = now;
+	OCR1A  = now + 255;
+	TIFR1  = 1 << OCF1A;
+}
+
+#if defined(USBCON)
+#ifdef CDC_ENABLED
+
+static uint8_t       _seq;
+static unsigned long _lastSend;
+
+// send the records as full packets, or whatever is there if they have been
+// waiting for FLUSH_MS or the capture is over
+void Capture_poll(void)
+{
+	uint8_t size = _two ? 3 : 2;
+	uint8_t full = (uint8_t) (PAYLOAD / size * size);
+	uint8_t tail = _tail;
+	uint8_t n = (uint8_t) (_head - tail);
+	if (n == 0)
+		return;
+	if (n >= full)
+		n = full;
+	else if (_running && millis() - _lastSend < FLUSH_MS)
+		return;
+
+	if (!Serial_connected())
+	{
+		_tail = (uint8_t) (tail + n);
+		_lost = 1;
+		return;
+	}
+
+	// a whole packet must fit, USB_Send() would wait otherwise
+	if (USB_SendSpace(CDC_TX) < PACKET_SIZE)
+		return;
+
+	// staged in one buffer and sent at once: the start of frame flush must
+	// not release the header as a packet of its own
+	u8 packet[PACKET_SIZE];
+	packet[0] = _seq++;
+	packet[1] = (u8) (n | (_two ? 0x40 : 0) | (_lost ? 0x80 : 0));
+	_lost = 0;
+
+	// the records may wrap around the end of the ring
+	uint16_t first = 256 - tail;
+	if (first > n)
+		first = n;
+	memcpy(packet + 2, _ring + tail, first);
+	memcpy(packet + 2 + first, _ring, n - first);
+	USB_Send(CDC_TX | TRANSFER_RELEASE, packet, 2 + n);
+
+	_tail = (uint8_t) (tail + n);
+	_lastSend = millis();
+}
+
+#endif
+#endif /* if defined(USBCON) */
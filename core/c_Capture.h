@@ -0,0 +1,67 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "c_USB.h"
+
+// Logic analyzer: captures one or two GPIO ports
+//
+// The ports are either sampled on each Timer1 compare A match or, in pin
+// change mode, read on every PCINT0 interrupt (pins of PCMSK0) with Timer1
+// counting time. Samples are run-length encoded into a 256-byte ring as
+// records of:
+//
+//     one value byte per port, then the number of ticks (1-255) it lasted
+//
+// so that a steady signal costs a record every 255 ticks. Capture_poll()
+// sends the records on the CDC bulk IN endpoint in packets of:
+//
+//     byte 0      sequence number
+//     byte 1      bits 5-0: number of record bytes that follow
+//                 bit 6:    two ports per record (one otherwise)
+//                 bit 7:    records were lost before this packet
+//
+// Records are never split across packets; tools/la2vcd turns the stream
+// into a VCD file. In one-shot mode, the capture stops when the ring is
+// full instead of losing records.
+
+#define CAPTURE_TIMER     0x00
+#define CAPTURE_PINCHANGE 0x01
+#define CAPTURE_ONESHOT   0x02
+
+#define CAPTURE_MAX_PORTS 2
+
+// ports are PB, PC... as used by portInputRegister(); masks select the pins
+// to record; rate is the number of ticks per second, which is rounded to a
+// Timer1 prescaler in pin change mode
+void     Capture_begin    (const uint8_t* ports, const uint8_t* masks, uint8_t count,
+                           uint32_t rate, uint8_t flags);
+void     Capture_end      (void);
+uint8_t  Capture_running  (void);
+uint32_t Capture_rate     (void);
+uint16_t Capture_overflows(void);
+
+#if defined(USBCON)
+#ifdef CDC_ENABLED
+void     Capture_poll     (void);
+#endif
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include "c_DAQ.h"
+
+#if defined(USBCON)
+#ifdef CDC_ENABLED
+
+#define PACKET_SIZE 64
+
+// word 0 is the header, the ADC writes the samples right after it
+static uint16_t _packets[2][PACKET_SIZE / 2];
+
+// rate in samples per second, 0 to let the ADC run freely (the sample rate
+// then depends on the prescaler given to ADC_begin())
+void DAQ_begin(uint8_t channel, uint16_t rate)
+{
+	ADC_stream(channel, rate, &_packets[0][1], &_packets[1][1], DAQ_SAMPLES);
+}
+
+void DAQ_end(void)
+{
+	ADC_stop();
+}
+
+// send the full packet, if any and if the endpoint has a free bank; call it
+// from loop() at least once per packet time (DAQ_SAMPLES sample periods)
+void DAQ_poll(void)
+{
+	uint16_t seq;
+	uint16_t* samples = ADC_next(&seq);
+	if (!samples)
+		return;
+
+	if (!Serial_connected())
+	{
+		ADC_release(samples);
+		return;
+	}
+
+	// USB_Send() would wait otherwise
+	if (USB_SendSpace(CDC_TX) < PACKET_SIZE)
+		return;
+
+	u8* packet = (u8*) (samples - 1);
+	packet[0] = (u8) seq;
+	packet[1] = DAQ_MAGIC;
+	USB_Send(CDC_TX | TRANSFER_RELEASE, packet, PACKET_SIZE);
+	ADC_release(samples);
+}
+
+#endif
+#endif /* if defined(USBCON) */
@@ -0,0 +1,50 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef DAQ_H
+#define DAQ_H
+
+#include "c_USB.h"
+#include "c_ADC.h"
+
+// Continuous ADC acquisition streamed over the CDC serial port
+//
+// The ADC stream fills the sample area of two 64-byte packets in turn. A
+// full packet is sent as is on the CDC bulk IN endpoint, in a single USB
+// transaction:
+//
+//     byte 0      sequence number (low 8 bits), counts dropped packets too
+//     byte 1      DAQ_MAGIC
+//     bytes 2-63  DAQ_SAMPLES samples, 16-bit little endian
+//
+// A sample never has 0xA5 as its high byte, which lets the reader find the
+// packet boundaries (see tools/adcread.c). Nothing is sent while the port
+// is closed on the host.
+
+#define DAQ_MAGIC   0xA5
+#define DAQ_SAMPLES 31
+
+#if defined(USBCON)
+#ifdef CDC_ENABLED
+void DAQ_begin(uint8_t channel, uint16_t rate);
+void DAQ_end  (void);
+void DAQ_poll (void);
+#endif
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+
+#include "c_Display.h"
+
+// segment patterns (a is the MSB, the decimal point the LSB)
+static const uint8_t _displayFont[] PROGMEM =
+{
+	0xFC, 0x60, 0xDA, 0xF2, 0x66, 0xB6, 0xBE, 0xE0, // 0-7
+	0xFE, 0xF6, 0xEE, 0x3E, 0x9C, 0x7A, 0x9E, 0x8E, // 8-F
+	0x02, 0x00,                                     // minus, blank
+};
+
+// port register and bit mask of a pin, resolved once so that the interrupt
+// does not go through digitalWrite()
+typedef struct
+{
+	volatile uint8_t* port;
+	uint8_t           mask;
+} Pin;
+
+volatile uint8_t Display_buffer[DISPLAY_MAX_DIGITS];
+
+static Pin     _segments[8];
+static Pin     _digits[DISPLAY_MAX_DIGITS];
+static uint8_t _count;
+static uint8_t _flags;
+static uint8_t _current;
+static uint8_t _maxTicks;
+
+static void initPin(Pin* pin, uint8_t n)
+{
+	uint8_t port = digitalPinToPort(n);
+	pin->port = portOutputRegister(port);
+	pin->mask = digitalPinToBitMask(n);
+	pinMode(n, OUTPUT);
+}
+
+static inline void writePin(const Pin* pin, uint8_t level)
+{
+	if (level)
+		*pin->port |= pin->mask;
+	else
+		*pin->port &= (uint8_t) ~pin->mask;
+}
+
+static inline void selectDigit(uint8_t i, uint8_t on)
+{
+	if (_digits[i].port)
+		writePin(&_digits[i], (_flags & DISPLAY_DIGITS_ACTIVE_HIGH) ? on : !on);
+}
+
+void Display_begin(const uint8_t* segments, const uint8_t* digits, uint8_t count, uint8_t flags)
+{
+	if (count > DISPLAY_MAX_DIGITS)
+		count = DISPLAY_MAX_DIGITS;
+	if (count == 0)
+		count = 1;
+
+	Display_end();
+	_flags = flags;
+	_count = count;
+	_current = 0;
+	_maxTicks = 0;
+
+	for (uint8_t i = 0; i < 8; i++)
+		initPin(&_segments[i], segments[i]);
+	for (uint8_t i = 0; i < DISPLAY_MAX_DIGITS; i++)
+	{
+		Display_buffer[i] = 0;
+		_digits[i].port = 0;
+		if (digits && i < count)
+		{
+			initPin(&_digits[i], digits[i]);
+			selectDigit(i, 0);
+		}
+	}
+
+	// Timer0 is already running for millis(); half a period away from the
+	// overflow interrupt so that both do not fire at once
+	OCR0A = 128;
+	TIFR0 = 1 << OCF0A;
+	TIMSK0 |= 1 << OCIE0A;
+}
+
+void Display_end(void)
+{
+	TIMSK0 &= (uint8_t) ~(1 << OCIE0A);
+	for (uint8_t i = 0; i < _count; i++)
+		selectDigit(i, 0);
+}
+
+uint8_t Display_encode(uint8_t value)
+{
+	if (value >= sizeof(_displayFont))
+		value = DISPLAY_BLANK;
+	return pgm_read_byte(_displayFont + value);
+}
+
+void Display_set(uint8_t pos, uint8_t value)
+{
+	if (pos < DISPLAY_MAX_DIGITS)
+		Display_buffer[pos] = Display_encode(value);
+}
+
+// right-aligned decimal number, with a minus sign if negative
+void Display_print(int16_t n)
+{
+	uint16_t u = n < 0 ? (uint16_t) (0u - (uint16_t) n) : (uint16_t) n; // -32768 too
+	uint8_t pos = _count;
+	do
+	{
+		Display_set(--pos, (uint8_t) (u % 10));
+		u /= 10;
+	} while (u && pos);
+	if (n < 0 && pos)
+		Display_set(--pos, DISPLAY_MINUS);
+	while (pos)
+		Display_set(--pos, DISPLAY_BLANK);
+}
+
+uint8_t Display_load(void)
+{
+	return _maxTicks;
+}
+
+// refresh the next digit
+ISR(TIMER0_COMPA_vect)
+{
+	uint8_t start = TCNT0;
+
+	selectDigit(_current, 0);
+	if (++_current >= _count)
+		_current = 0;
+
+	uint8_t code = Display_buffer[_current];
+	if (_flags & DISPLAY_SEGMENTS_ACTIVE_LOW)
+		code = (uint8_t) ~code;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		writePin(&_segments[i], code & 0x80);
+		code = (uint8_t) (code << 1);
+	}
+
+	selectDigit(_current, 1);
+
+	uint8_t ticks = (uint8_t) (TCNT0 - start);
+	if (ticks > _maxTicks)
+		_maxTicks = ticks;
+}
@@ -0,0 +1,63 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <Arduino.h>
+
+// Multiplexed display driver
+//
+// The display is refreshed from the Timer0 compare A interrupt (Timer0 also
+// runs millis(), so no timer is lost): one digit (or row) is lit per tick,
+// that is every 1.024 ms at 16 MHz. The program only writes segment patterns
+// into Display_buffer; it never touches the pins itself.
+//
+// Note: using analogWrite() on the OC0A pin (11 on Leonardo, 6 on Uno) moves
+// the compare point but does not break the refresh.
+
+#define DISPLAY_MAX_DIGITS 8
+
+// flags for Display_begin()
+#define DISPLAY_COMMON_CATHODE      0x00
+#define DISPLAY_SEGMENTS_ACTIVE_LOW 0x01
+#define DISPLAY_DIGITS_ACTIVE_HIGH  0x02
+#define DISPLAY_COMMON_ANODE        (DISPLAY_SEGMENTS_ACTIVE_LOW | DISPLAY_DIGITS_ACTIVE_HIGH)
+
+// special codes for Display_encode()
+#define DISPLAY_MINUS 16
+#define DISPLAY_BLANK 17
+
+// one segment pattern per digit, leftmost first
+// bit 7 is segment a, bit 1 is segment g and bit 0 is the decimal point
+extern volatile uint8_t Display_buffer[DISPLAY_MAX_DIGITS];
+
+// segments: 8 pins, in order a, b, c, d, e, f, g, DP
+// digits:   common pin of each digit, leftmost first (NULL for a single,
+//           always enabled digit)
+void    Display_begin (const uint8_t* segments, const uint8_t* digits, uint8_t count, uint8_t flags);
+void    Display_end   (void);
+uint8_t Display_encode(uint8_t value);
+void    Display_set   (uint8_t pos, uint8_t value);
+void    Display_print (int16_t n);
+
+// longest refresh interrupt seen so far, in Timer0 ticks (64 cycles); since
+// the interrupt runs once per 256 ticks, this is also the CPU share in 1/256
+uint8_t Display_load  (void);
+
+#endif
@@ -0,0 +1,204 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/interrupt.h>
+
+#include "c_EEPROM.h"
+
+// pending writes, oldest first
+static uint16_t         _address[EEPROM_CACHE_SIZE];
+static uint8_t          _value  [EEPROM_CACHE_SIZE];
+static uint8_t          _first;
+static volatile uint8_t _count;
+
+// index of the cache entry for address, EEPROM_CACHE_SIZE if none;
+// interrupts must be disabled
+static uint8_t find(uint16_t address)
+{
+	uint8_t i = _first;
+	for (uint8_t n = _count; n; n--)
+	{
+		if (_address[i] == address)
+			return i;
+		if (++i == EEPROM_CACHE_SIZE)
+			i = 0;
+	}
+	return EEPROM_CACHE_SIZE;
+}
+
+uint8_t EEPROM_read(uint16_t address)
+{
+	for (;;)
+	{
+		uint8_t sreg = SREG;
+		cli();
+		uint8_t i = find(address);
+		if (i != EEPROM_CACHE_SIZE)
+		{
+			uint8_t value = _value[i];
+			SREG = sreg;
+			return value;
+		}
+		// the EEPROM cannot be read while a byte is being written
+		if (!(EECR & (1 << EEPE)))
+		{
+			EEAR = address;
+			EECR |= 1 << EERE;
+			uint8_t value = EEDR;
+			SREG = sreg;
+			return value;
+		}
+		SREG = sreg;
+	}
+}
+
+void EEPROM_readBytes(uint16_t address, void* buffer, uint16_t size)
+{
+	uint8_t* p = (uint8_t*) buffer;
+	while (size--)
+		*p++ = EEPROM_read(address++);
+}
+
+void EEPROM_write(uint16_t address, uint8_t value)
+{
+	for (;;)
+	{
+		uint8_t sreg = SREG;
+		cli();
+		uint8_t i = find(address);
+		if (i != EEPROM_CACHE_SIZE)
+		{
+			_value[i] = value;
+			SREG = sreg;
+			return;
+		}
+		if (_count < EEPROM_CACHE_SIZE)
+		{
+			i = _first + _count;
+			if (i >= EEPROM_CACHE_SIZE)
+				i -= EEPROM_CACHE_SIZE;
+			_address[i] = address;
+			_value[i]   = value;
+			_count++;
+			EECR |= 1 << EERIE;
+			SREG = sreg;
+			return;
+		}
+		// full, wait for the interrupt to commit an entry
+		SREG = sreg;
+	}
+}
+
+void EEPROM_writeBytes(uint16_t address, const void* buffer, uint16_t size)
+{
+	const uint8_t* p = (const uint8_t*) buffer;
+	while (size--)
+		EEPROM_write(address++, *p++);
+}
+
+// number of bytes still to be committed
+uint8_t EEPROM_pending(void)
+{
+	return _count;
+}
+
+// waits until everything is committed
+void EEPROM_flush(void)
+{
+	while (_count || (EECR & (1 << EEPE)));
+}
+
+// sequence numbers go from 0 to 254, 0xFF is an erased byte
+static uint8_t nextSeq(uint8_t seq)
+{
+	return seq == 254 ? 0 : (uint8_t) (seq + 1);
+}
+
+static uint16_t slotAddress(const EEPROMRing* ring, uint8_t slot)
+{
+	return (uint16_t) (ring->base + slot * (ring->size + 1));
+}
+
+// the last record is the one not followed by the next sequence number
+uint8_t EEPROM_load(EEPROMRing* ring, uint16_t base, uint8_t size, uint8_t slots, void* data)
+{
+	ring->base  = base;
+	ring->size  = size;
+	ring->slots = slots;
+	ring->slot  = slots - 1;
+	ring->seq   = 0xFF;
+
+	for (uint8_t i = 0; i < slots; i++)
+	{
+		uint8_t seq = EEPROM_read(slotAddress(ring, i) + size);
+		if (seq == 0xFF)
+			continue;
+		uint8_t j = i + 1 == slots ? 0 : i + 1;
+		if (EEPROM_read(slotAddress(ring, j) + size) != nextSeq(seq))
+		{
+			ring->slot = i;
+			ring->seq  = seq;
+			break;
+		}
+	}
+	if (ring->seq == 0xFF)
+		return 0;
+	EEPROM_readBytes(slotAddress(ring, ring->slot), data, size);
+	return 1;
+}
+
+void EEPROM_save(EEPROMRing* ring, const void* data)
+{
+	ring->slot = ring->slot + 1 == ring->slots ? 0 : ring->slot + 1;
+	ring->seq  = nextSeq(ring->seq);
+	uint16_t address = slotAddress(ring, ring->slot);
+	EEPROM_writeBytes(address, data, ring->size);
+	EEPROM_write(address + ring->size, ring->seq);
+}
+
+// the interrupt fires as long as the EEPROM is ready and EERIE is set
+ISR(EE_READY_vect)
+{
+	while (_count)
+	{
+		uint16_t address = _address[_first];
+		uint8_t  value   = _value[_first];
+		if (++_first == EEPROM_CACHE_SIZE)
+			_first = 0;
+		_count--;
+
+		EEAR = address;
+		EECR |= 1 << EERE;
+		uint8_t old = EEDR;
+		if (old == value)
+			continue;
+
+		// erase only, write only (bits only go from 1 to 0), or both
+		uint8_t mode = 0;
+		if (value == 0xFF)
+			mode = 1 << EEPM0;
+		else if ((old & value) == value)
+			mode = 1 << EEPM1;
+		EEDR = value;
+		EECR = (uint8_t) (mode | (1 << EERIE));
+		EECR |= 1 << EEMPE;
+		EECR |= 1 << EEPE;
+		return;
+	}
+	EECR &= (uint8_t) ~(1 << EERIE);
+}
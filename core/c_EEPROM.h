@@ -0,0 +1,64 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <Arduino.h>
+
+// Write-behind EEPROM
+//
+// Writes are staged in a RAM cache and committed one byte at a time from
+// the EEPROM ready interrupt, so that they do not stall the caller (a byte
+// takes about 3.4 ms). Bytes whose value is unchanged are skipped, and a
+// byte that only needs an erase or only a write gets the shorter operation.
+// Reads see the cache first, and thus always return the latest value.
+// Writing to a byte that is still in the cache only changes the cached
+// value; writing when the cache is full waits for an entry to be committed.
+//
+// Rings spread a record over several slots for wear levelling: each save
+// goes to the next slot, followed by a sequence byte written last, so that
+// a save interrupted by a reset leaves the previous record in place. A slot
+// takes size + 1 bytes; EEPROM_load() sets a ring up and must come before
+// EEPROM_save().
+
+#ifndef EEPROM_CACHE_SIZE
+#define EEPROM_CACHE_SIZE 16
+#endif
+
+uint8_t  EEPROM_read      (uint16_t address);
+void     EEPROM_readBytes (uint16_t address, void* buffer, uint16_t size);
+void     EEPROM_write     (uint16_t address, uint8_t value);
+void     EEPROM_writeBytes(uint16_t address, const void* buffer, uint16_t size);
+uint8_t  EEPROM_pending   (void);
+void     EEPROM_flush     (void);
+
+typedef struct
+{
+	uint16_t base;
+	uint8_t  size;  // of a record
+	uint8_t  slots; // fewer than 255
+	uint8_t  slot;  // of the last record
+	uint8_t  seq;   // of the last record, 0xFF if none
+} EEPROMRing;
+
+// finds the last record and copies it to data; returns 0 if there is none
+uint8_t  EEPROM_load(EEPROMRing* ring, uint16_t base, uint8_t size, uint8_t slots, void* data);
+void     EEPROM_save(EEPROMRing* ring, const void* data);
+
+#endif
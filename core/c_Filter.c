@@ -0,0 +1,253 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "c_Filter.h"
+
+// acc + a * b
+static inline int32_t mac(int32_t acc, int16_t a, int16_t b)
+{
+#if defined(__AVR_HAVE_MUL__)
+	// the 4 partial products, the cross ones being signed x unsigned;
+	// the carry of MULSU is the sign of its product, subtracted from the
+	// top byte to extend it
+	uint8_t zero;
+	__asm__
+	(
+		"clr   %[z]"           "\n\t"
+		"muls  %B[a], %B[b]"   "\n\t"
+		"add   %C[acc], r0"    "\n\t"
+		"adc   %D[acc], r1"    "\n\t"
+		"mul   %A[a], %A[b]"   "\n\t"
+		"add   %A[acc], r0"    "\n\t"
+		"adc   %B[acc], r1"    "\n\t"
+		"adc   %C[acc], %[z]"  "\n\t"
+		"adc   %D[acc], %[z]"  "\n\t"
+		"mulsu %B[a], %A[b]"   "\n\t"
+		"sbc   %D[acc], %[z]"  "\n\t"
+		"add   %B[acc], r0"    "\n\t"
+		"adc   %C[acc], r1"    "\n\t"
+		"adc   %D[acc], %[z]"  "\n\t"
+		"mulsu %B[b], %A[a]"   "\n\t"
+		"sbc   %D[acc], %[z]"  "\n\t"
+		"add   %B[acc], r0"    "\n\t"
+		"adc   %C[acc], r1"    "\n\t"
+		"adc   %D[acc], %[z]"  "\n\t"
+		"clr   __zero_reg__"
+		: [acc] "+r" (acc), [z] "=&r" (zero)
+		: [a] "a" (a), [b] "a" (b)
+	);
+	return acc;
+#else
+	return (int32_t) ((uint32_t) acc + (uint32_t) ((int32_t) a * b));
+#endif
+}
+
+// acc + 2 a b: Q15 x Q15 accumulated in Q31
+static inline int32_t fmac(int32_t acc, int16_t a, int16_t b)
+{
+#if defined(__AVR_HAVE_MUL__)
+	// same with the FMUL* instructions, which shift the products left;
+	// their carry is the bit shifted out, for FMUL the bit 16 of the
+	// product, added before anything else changes the carry
+	uint8_t zero;
+	__asm__
+	(
+		"clr    %[z]"           "\n\t"
+		"fmul   %A[a], %A[b]"   "\n\t"
+		"adc    %C[acc], %[z]"  "\n\t"
+		"adc    %D[acc], %[z]"  "\n\t"
+		"add    %A[acc], r0"    "\n\t"
+		"adc    %B[acc], r1"    "\n\t"
+		"adc    %C[acc], %[z]"  "\n\t"
+		"adc    %D[acc], %[z]"  "\n\t"
+		"fmuls  %B[a], %B[b]"   "\n\t"
+		"add    %C[acc], r0"    "\n\t"
+		"adc    %D[acc], r1"    "\n\t"
+		"fmulsu %B[a], %A[b]"   "\n\t"
+		"sbc    %D[acc], %[z]"  "\n\t"
+		"add    %B[acc], r0"    "\n\t"
+		"adc    %C[acc], r1"    "\n\t"
+		"adc    %D[acc], %[z]"  "\n\t"
+		"fmulsu %B[b], %A[a]"   "\n\t"
+		"sbc    %D[acc], %[z]"  "\n\t"
+		"add    %B[acc], r0"    "\n\t"
+		"adc    %C[acc], r1"    "\n\t"
+		"adc    %D[acc], %[z]"  "\n\t"
+		"clr    __zero_reg__"
+		: [acc] "+r" (acc), [z] "=&r" (zero)
+		: [a] "a" (a), [b] "a" (b)
+	);
+	return acc;
+#else
+	return (int32_t) ((uint32_t) acc + ((uint32_t) ((int32_t) a * b) << 1));
+#endif
+}
+
+static int16_t saturate(int32_t v)
+{
+	if (v > INT16_MAX)
+		return INT16_MAX;
+	if (v < INT16_MIN)
+		return INT16_MIN;
+	return (int16_t) v;
+}
+
+//==================================================================
+//                         MOVING AVERAGE
+//==================================================================
+
+void Filter_beginAverage(MovingAverage* f, int16_t* buffer, uint8_t shift)
+{
+	f->buffer = buffer;
+	f->shift  = shift > 8 ? 8 : shift;
+	f->index  = 0;
+	f->sum    = 0;
+	memset(buffer, 0, sizeof(int16_t) << f->shift);
+}
+
+int16_t Filter_average(MovingAverage* f, int16_t x)
+{
+	uint8_t i = f->index;
+	f->sum += (int32_t) x - f->buffer[i];
+	f->buffer[i] = x;
+	f->index = (uint8_t) ((i + 1) & ((1 << f->shift) - 1));
+	return (int16_t) ((f->sum + ((1L << f->shift) >> 1)) >> f->shift);
+}
+
+//==================================================================
+//                              FIR
+//==================================================================
+
+void Filter_beginFIR(FIRFilter* f, const int16_t* coefficients, int16_t* delay, uint8_t taps)
+{
+	f->coefficients = coefficients;
+	f->delay        = delay;
+	f->taps         = taps;
+	f->index        = 0;
+	memset(delay, 0, 2 * sizeof(int16_t) * taps);
+}
+
+// the samples are stored twice, taps apart, from the most recent: the
+// last taps samples are always in a row, from delay + index
+void Filter_pushFIR(FIRFilter* f, int16_t x)
+{
+	uint8_t i = f->index ? (uint8_t) (f->index - 1) : (uint8_t) (f->taps - 1);
+	f->delay[i] = x;
+	f->delay[i + f->taps] = x;
+	f->index = i;
+}
+
+int16_t Filter_outputFIR(FIRFilter* f)
+{
+	const int16_t* c = f->coefficients;
+	const int16_t* x = f->delay + f->index;
+	int32_t acc = 0x8000; // rounds the high word
+	for (uint8_t k = f->taps; k; k--)
+		acc = fmac(acc, (int16_t) pgm_read_word(c++), *x++);
+	return (int16_t) (acc >> 16);
+}
+
+int16_t Filter_fir(FIRFilter* f, int16_t x)
+{
+	Filter_pushFIR(f, x);
+	return Filter_outputFIR(f);
+}
+
+//==================================================================
+//                             BIQUAD
+//==================================================================
+
+// -2 has no Q14 opposite: it becomes 2 - 2^-14
+static inline int16_t negate(int16_t a)
+{
+	return a == INT16_MIN ? INT16_MAX : (int16_t) -a;
+}
+
+void Filter_beginBiquad(Biquad* f, const int16_t* coefficients)
+{
+	f->b0 = (int16_t) pgm_read_word(coefficients);
+	f->b1 = (int16_t) pgm_read_word(coefficients + 1);
+	f->b2 = (int16_t) pgm_read_word(coefficients + 2);
+	f->a1 = negate((int16_t) pgm_read_word(coefficients + 3));
+	f->a2 = negate((int16_t) pgm_read_word(coefficients + 4));
+	f->x1 = f->x2 = 0;
+	f->y1 = f->y2 = 0;
+}
+
+int16_t Filter_biquad(Biquad* f, int16_t x)
+{
+	int32_t acc = 1L << 13; // rounds the Q14 result
+	acc = mac(acc, f->b0, x);
+	acc = mac(acc, f->b1, f->x1);
+	acc = mac(acc, f->b2, f->x2);
+	acc = mac(acc, f->a1, f->y1);
+	acc = mac(acc, f->a2, f->y2);
+	int16_t y = saturate(acc >> 14);
+
+	f->x2 = f->x1;
+	f->x1 = x;
+	f->y2 = f->y1;
+	f->y1 = y;
+	return y;
+}
+
+//==================================================================
+//                              CIC
+//==================================================================
+
+void Filter_beginCIC(CICDecimator* f, uint8_t order, uint8_t shift)
+{
+	memset(f, 0, sizeof(*f));
+	f->order = order < 1 ? 1 : order > FILTER_CIC_MAX_ORDER ? FILTER_CIC_MAX_ORDER : order;
+	// the registers hold the gain of 2^(order x shift) if it is up to 2^16
+	uint8_t most = (uint8_t) (16 / f->order);
+	if (most > 15)
+		most = 15;
+	f->shift = shift > most ? most : shift;
+}
+
+boolean Filter_cic(CICDecimator* f, int16_t x, int16_t* y)
+{
+	// integrators at the input rate, wrapping around: the combs undo it
+	uint32_t v = (uint32_t) (int32_t) x;
+	for (uint8_t i = 0; i < f->order; i++)
+		v = f->integrators[i] += v;
+	if (++f->count < (uint16_t) (1U << f->shift))
+		return false;
+	f->count = 0;
+
+	// combs at the output rate
+	for (uint8_t i = 0; i < f->order; i++)
+	{
+		uint32_t t = v - f->combs[i];
+		f->combs[i] = v;
+		v = t;
+	}
+
+	// gain of 2^(order x shift)
+	uint8_t gain = (uint8_t) (f->order * f->shift);
+	int32_t r = (int32_t) v;
+	if (gain)
+		r = (r + ((int32_t) 1 << (gain - 1))) >> gain;
+	*y = saturate(r);
+	return true;
+}
@@ -0,0 +1,104 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <Arduino.h>
+
+// Fixed-point filters for 16-bit samples
+//
+// The samples are int16_t, as read from the ADC (scaled up if need be, to
+// keep the precision). The products are accumulated on 32 bits by inline
+// assembly using the hardware multiplier (signed 16 x 16 multiply and
+// accumulate of Atmel's AVR201 application note, FMUL* for Q15 and MUL*
+// otherwise), with a C version for the cores without it. Each filter keeps
+// its state in a structure, and buffers given by the caller.
+//
+// Approximate cost, estimated from the instructions of the inner loops:
+//
+//     moving average   30 cycles per sample (no multiplication)
+//     FIR              40 cycles per tap, plus 60 per sample
+//     biquad           200 cycles per sample
+//     CIC              20 cycles per stage and per input sample, plus 30
+//                      per stage and per output sample (no multiplication)
+
+// moving average of 2^shift samples (shift up to 8)
+typedef struct
+{
+	int16_t* buffer; // 2^shift samples
+	uint8_t  shift;
+	uint8_t  index;
+	int32_t  sum;
+} MovingAverage;
+
+void    Filter_beginAverage(MovingAverage* f, int16_t* buffer, uint8_t shift);
+int16_t Filter_average     (MovingAverage* f, int16_t x);
+
+// FIR filter: y = sum of c[k] x[n-k]; the Q15 coefficients, in program
+// memory, must add up (in absolute value) to 1 at most; the delay line
+// holds 2 x taps samples, so that the past samples are contiguous. To
+// decimate, push the samples and compute the output every N samples.
+typedef struct
+{
+	const int16_t* coefficients; // in program memory
+	int16_t*       delay;        // 2 x taps samples
+	uint8_t        taps;
+	uint8_t        index;
+} FIRFilter;
+
+void    Filter_beginFIR (FIRFilter* f, const int16_t* coefficients, int16_t* delay, uint8_t taps);
+void    Filter_pushFIR  (FIRFilter* f, int16_t x);
+int16_t Filter_outputFIR(FIRFilter* f);
+int16_t Filter_fir      (FIRFilter* f, int16_t x); // push, then output
+
+// biquad (direct form I): y = b0 x0 + b1 x1 + b2 x2 - a1 y1 - a2 y2, with
+// Q14 coefficients (-2 to 2) given as { b0, b1, b2, a1, a2 } in program
+// memory; cascade them for higher orders; an a1 or a2 of exactly -2 is
+// taken as -1.99994
+typedef struct
+{
+	int16_t b0, b1, b2;
+	int16_t a1, a2; // negated
+	int16_t x1, x2;
+	int16_t y1, y2;
+} Biquad;
+
+void    Filter_beginBiquad(Biquad* f, const int16_t* coefficients);
+int16_t Filter_biquad     (Biquad* f, int16_t x);
+
+// CIC decimator: order stages (up to 4), decimating by 2^shift, with
+// order x shift up to 16 (shift is lowered to fit); the gain is compensated
+#define FILTER_CIC_MAX_ORDER 4
+
+typedef struct
+{
+	uint32_t integrators[FILTER_CIC_MAX_ORDER]; // wrapping around
+	uint32_t combs      [FILTER_CIC_MAX_ORDER];
+	uint8_t  order;
+	uint8_t  shift;
+	uint16_t count;
+} CICDecimator;
+
+void    Filter_beginCIC(CICDecimator* f, uint8_t order, uint8_t shift);
+
+// returns true, with the output in y, every 2^shift samples
+boolean Filter_cic     (CICDecimator* f, int16_t x, int16_t* y);
+
+#endif
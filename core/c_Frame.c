@@ -0,0 +1,181 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include "c_Frame.h"
+#include "c_CRC.h"
+
+#if FRAME_CRC == 32
+#define CRC     CRC32
+#define INIT    CRC32_INIT
+#define RESIDUE CRC32_RESIDUE
+#else
+#define CRC     CRC16
+#define INIT    CRC16_INIT
+#define RESIDUE CRC16_RESIDUE
+#endif
+
+// the payload then the CRC; COBS blocks are at most 254 bytes, a code
+// byte of 0xFF meaning that the block is not followed by a zero
+void Frame_send(FrameWrite write, const void* payload, size_t size)
+{
+	uint8_t crc[FRAME_CRC_SIZE];
+#if FRAME_CRC == 32
+	uint32_t c = ~CRC32(CRC32_INIT, payload, size);
+	for (uint8_t i = 0; i < 4; i++, c >>= 8)
+		crc[i] = (uint8_t) c;
+#else
+	uint16_t c = CRC16(CRC16_INIT, payload, size);
+	crc[0] = (uint8_t) (c >> 8);
+	crc[1] = (uint8_t) c;
+#endif
+
+	const uint8_t* data[2] = { (const uint8_t*) payload, crc };
+	size_t         len [2] = { size, FRAME_CRC_SIZE };
+	uint8_t        s = size ? 0 : 1; // current part and position in it
+	size_t         i = 0;
+	for (;;)
+	{
+		// length of the block: up to the next zero
+		uint8_t n  = 0;
+		uint8_t ts = s;
+		size_t  ti = i;
+		while (n < 254)
+		{
+			if (ti == len[ts])
+			{
+				if (ts)
+					break;
+				ts = 1;
+				ti = 0;
+			}
+			if (!data[ts][ti])
+				break;
+			n++;
+			ti++;
+		}
+
+		uint8_t code = (uint8_t) (n + 1);
+		write(&code, 1);
+		while (n)
+		{
+			size_t piece = len[s] - i;
+			if (piece > n)
+				piece = n;
+			write(data[s] + i, piece);
+			n = (uint8_t) (n - piece);
+			i += piece;
+			if (i == len[s] && !s)
+			{
+				s = 1;
+				i = 0;
+			}
+		}
+
+		if (s && i == len[1])
+			break;
+		if (code != 0xFF)
+		{
+			// the zero the block stands for
+			if (++i == len[s] && !s)
+			{
+				s = 1;
+				i = 0;
+			}
+		}
+	}
+
+	uint8_t delimiter = 0;
+	write(&delimiter, 1);
+}
+
+static void restart(FrameDecoder* d)
+{
+	d->length    = 0;
+	d->crc       = INIT;
+	d->remaining = 0;
+	d->zero      = 0;
+	d->started   = 0;
+	d->discard   = 0;
+}
+
+void Frame_begin(FrameDecoder* d, uint8_t* buffer, size_t capacity)
+{
+	d->buffer   = buffer;
+	d->capacity = capacity;
+	d->errors   = 0;
+	restart(d);
+}
+
+static void put(FrameDecoder* d, uint8_t value)
+{
+	if (d->length == d->capacity)
+	{
+		d->discard = 1;
+		d->errors++;
+		return;
+	}
+	d->buffer[d->length++] = value;
+	d->crc = CRC(d->crc, &value, 1);
+}
+
+int Frame_receive(FrameDecoder* d, uint8_t c)
+{
+	if (!c)
+	{
+		// end of frame
+		int r = -1;
+		if (d->discard || !d->started)
+			; // already counted, or no frame at all
+		else if (d->remaining || d->length < FRAME_CRC_SIZE || d->crc != RESIDUE)
+			d->errors++;
+		else
+			r = (int) (d->length - FRAME_CRC_SIZE);
+		restart(d);
+		return r;
+	}
+
+	if (d->discard)
+		return -1;
+	d->started = 1;
+	if (d->remaining)
+	{
+		put(d, c);
+		d->remaining--;
+	}
+	else
+	{
+		// code byte of a new block
+		if (d->zero)
+			put(d, 0);
+		d->zero      = c != 0xFF;
+		d->remaining = (uint8_t) (c - 1);
+	}
+	return -1;
+}
+
+int Frame_poll(FrameDecoder* d, FrameRead read)
+{
+	int c;
+	while ((c = read()) >= 0)
+	{
+		int n = Frame_receive(d, (uint8_t) c);
+		if (n >= 0)
+			return n;
+	}
+	return -1;
+}
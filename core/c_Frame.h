@@ -0,0 +1,73 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <Arduino.h>
+
+// COBS framing with a CRC, over any byte stream (CDC, UART...)
+//
+// A frame is the payload followed by its CRC (see c_CRC.h), encoded with
+// COBS so that it has no zero byte, then a zero byte that ends it. The
+// encoder writes the payload straight from the caller's memory, between
+// COBS code bytes. The decoder takes the bytes one by one as they arrive;
+// frames that are corrupt (CRC, COBS encoding) or too long are dropped and
+// decoding resumes after the next zero byte.
+
+// 16 or 32
+#ifndef FRAME_CRC
+#define FRAME_CRC 16
+#endif
+#define FRAME_CRC_SIZE (FRAME_CRC / 8)
+
+// same as UART_writeBytes() and UART_read(); read() returns -1 when there
+// is nothing to read
+typedef size_t (*FrameWrite)(const uint8_t* data, size_t size);
+typedef int    (*FrameRead) (void);
+
+#if FRAME_CRC == 32
+typedef uint32_t FrameCRC;
+#else
+typedef uint16_t FrameCRC;
+#endif
+
+typedef struct
+{
+	uint8_t* buffer;
+	size_t   capacity;  // payload and CRC
+	size_t   length;
+	FrameCRC crc;
+	uint8_t  remaining; // bytes left in the current COBS block
+	uint8_t  zero;      // the current block stands for a zero at its end
+	uint8_t  started;
+	uint8_t  discard;   // skipping a corrupt frame
+	uint16_t errors;
+} FrameDecoder;
+
+void Frame_send   (FrameWrite write, const void* payload, size_t size);
+
+// the buffer takes the payload and its CRC; the payload of the frames is
+// left at its start
+void Frame_begin  (FrameDecoder* d, uint8_t* buffer, size_t capacity);
+
+// return the payload length once a valid frame is complete, -1 otherwise
+int  Frame_receive(FrameDecoder* d, uint8_t c);
+int  Frame_poll   (FrameDecoder* d, FrameRead read);
+
+#endif
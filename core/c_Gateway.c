@@ -0,0 +1,78 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#include "c_Gateway.h"
+
+#if defined(USBCON)
+#ifdef CDC_ENABLED
+
+static uint8_t  _pending; // bytes in the SPI buffer being filled
+static uint32_t _since;   // millis() when that changed
+
+void Gateway_begin(uint8_t mode)
+{
+	SPI_begin(mode, 0, 0, 0);
+	_pending = 0;
+}
+
+void Gateway_end(void)
+{
+	SPI_end();
+}
+
+// send the full buffer, if any and if the endpoint has a free bank; call it
+// from loop() at least once per buffer time
+void Gateway_poll(void)
+{
+	uint8_t size;
+	uint8_t* data = SPI_next(&size);
+	if (!data)
+	{
+		uint8_t pending = SPI_pending();
+		uint32_t now = millis();
+		if (pending != _pending)
+		{
+			_pending = pending;
+			_since = now;
+			return;
+		}
+		if (!pending || now - _since < GATEWAY_FLUSH_MS)
+			return;
+		SPI_flush();
+		_pending = 0;
+		if (!(data = SPI_next(&size)))
+			return;
+	}
+
+	if (!Serial_connected())
+	{
+		SPI_release();
+		return;
+	}
+
+	// USB_Send() would wait otherwise
+	if (USB_SendSpace(CDC_TX) < size)
+		return;
+
+	USB_Send(CDC_TX | TRANSFER_RELEASE, data, size);
+	SPI_release();
+}
+
+#endif
+#endif /* if defined(USBCON) */
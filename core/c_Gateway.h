@@ -0,0 +1,48 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "c_USB.h"
+#include "c_SPI.h"
+
+// SPI to USB gateway
+//
+// The stream an SPI master sends with SPI_STREAM (see c_SPI.h) goes out
+// on the CDC bulk IN endpoint: each full SPI buffer is sent as is, from
+// where the interrupt wrote it, as one 64-byte packet; the bytes of a
+// partial buffer follow in a short packet once the master has sent
+// nothing for GATEWAY_FLUSH_MS. The stream carries no boundaries of its
+// own: send frames of c_Frame.h through it to keep them. Nothing is sent
+// while the port is closed on the host (the stream is dropped); the master
+// should check SPI_SPACE before each frame.
+
+#define GATEWAY_FLUSH_MS 2
+
+#if defined(USBCON)
+#ifdef CDC_ENABLED
+// SPI mode 0-3; the registers of SPI_begin() are not used
+void Gateway_begin(uint8_t mode);
+void Gateway_end  (void);
+void Gateway_poll (void);
+#endif
+#endif
+
+#endif
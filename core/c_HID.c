@@ -138,26 +138,39 @@ u8 _hid_idle = 1;
 
 #define WEAK __attribute__ ((weak))
 
-int WEAK HID_GetInterface(u8* interfaceNum)
+int WEAK HID_GetInterface(USBClass* c, u8* interfaceNum)
 {
+	(void) c;
 	interfaceNum[0] += 1;	// uses 1
 	return USB_SendControl(TRANSFER_PGM,&_hidInterface,sizeof(_hidInterface));
 }
 
-int WEAK HID_GetDescriptor(int i)
+int WEAK HID_GetDescriptor(USBClass* c, int i)
 {
-	(void) i;
+	(void) c;
+	if (HID_REPORT_DESCRIPTOR_TYPE != i)
+		return 0;
 	return USB_SendControl(TRANSFER_PGM,_hidReportDescriptor,sizeof(_hidReportDescriptor));
 }
 
 void WEAK HID_SendReport(u8 id, const void* data, int len)
 {
-	USB_Send(HID_TX, &id, 1);
-	USB_Send(HID_TX | TRANSFER_RELEASE,data,len);
+	// one transfer, so that a report sent from an interrupt (see c_Keys.h)
+	// does not come between the identifier and the data
+	u8 report[1 + 64];
+	if (len < 0 || len > 64)
+		return;
+	report[0] = id;
+	memcpy(report + 1, data, (size_t) len);
+
+	// the report waits in the endpoint until the host resumes
+	USB_wakeup();
+	USB_Send(HID_TX | TRANSFER_RELEASE, report, len + 1);
 }
 
-bool WEAK HID_Setup(Setup* setup)
+bool WEAK HID_Setup(USBClass* c, Setup* setup)
 {
+	(void) c;
 	u8 r = setup->bRequest;
 	u8 requestType = setup->bmRequestType;
 	if (REQUEST_DEVICETOHOST_CLASS_INTERFACE == requestType)
@@ -0,0 +1,263 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#include <string.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+
+#include "c_Keys.h"
+
+#if defined(USBCON)
+#ifdef HID_ENABLED
+
+#if !defined(TCCR4B)
+#error "the key matrix needs Timer4 (ATmega32u4)"
+#endif
+
+#define PORTS       5    // B to F
+#define REPORT_ID   2    // keyboard, in _hidReportDescriptor
+#define REPORT_KEYS 6
+#define ROLLOVER    0x01 // usage of each key slot when too many are pressed
+
+static const KeyMatrix*  _matrix;
+
+static volatile uint8_t* _rowDdr [KEYS_MAX_ROWS];
+static uint8_t           _rowMask[KEYS_MAX_ROWS];
+static volatile uint8_t* _ports  [PORTS]; // input registers of the columns
+static uint8_t           _portCount;
+static uint8_t           _colPort[KEYS_MAX_COLUMNS];
+static uint8_t           _colMask[KEYS_MAX_COLUMNS];
+
+static volatile uint16_t _state[KEYS_MAX_ROWS]; // debounced, bit per column
+static uint16_t          _busy [KEYS_MAX_ROWS]; // keys whose timer runs
+static uint8_t           _timer[KEYS_MAX_ROWS][KEYS_MAX_COLUMNS];
+
+static uint8_t           _report[2 + REPORT_KEYS];
+static volatile boolean  _pending; // _report waits for the next frame
+
+static void Keys_SOF(USBClass* c)
+{
+	(void) c;
+	if (_pending && USB_SendSpace(HID_TX) > sizeof(_report))
+	{
+		_pending = false;
+		HID_SendReport(REPORT_ID, _report, sizeof(_report));
+	}
+}
+
+static USBClass _keys = { 0, 0, 0, 0, 0, 0, Keys_SOF, 0, 0, 0 };
+
+// modifiers, a reserved byte, then up to 6 keys in the order of the matrix
+static void buildReport(void)
+{
+	const KeyMatrix* m = _matrix;
+	const uint8_t* usages = m->keymap;
+	uint8_t n = 2;
+	boolean rollover = false;
+
+	memset(_report, 0, sizeof(_report));
+	for (uint8_t r = 0; r < m->rows; r++)
+	{
+		uint16_t keys = _state[r];
+		for (uint8_t c = 0; c < m->columns; c++, usages++, keys >>= 1)
+		{
+			if (!(keys & 1))
+				continue;
+			uint8_t usage = pgm_read_byte(usages);
+			if (usage >= 0xE0 && usage <= 0xE7)
+				_report[0] |= (uint8_t) (1 << (usage - 0xE0));
+			else if (!usage)
+				continue;
+			else if (n < sizeof(_report))
+				_report[n++] = usage;
+			else
+				rollover = true;
+		}
+	}
+	if (rollover)
+		memset(_report + 2, ROLLOVER, REPORT_KEYS);
+	_pending = true;
+}
+
+// keys: those that differ from their debounced state or whose timer runs;
+// returns whether a debounced key changed
+static boolean debounce(uint8_t r, uint16_t raw, uint16_t keys)
+{
+	const KeyMatrix* m = _matrix;
+	boolean changed = false;
+	uint16_t bit = 1;
+	for (uint8_t c = 0; c < m->columns; c++, bit <<= 1)
+	{
+		if (!(keys & bit))
+			continue;
+		uint8_t* t = &_timer[r][c];
+		boolean differs = ((raw ^ _state[r]) & bit) != 0;
+
+		if (m->algorithm == KEYS_EAGER)
+		{
+			// locked for the debounce time after a change
+			if (*t && --*t)
+				continue;
+			_busy[r] &= (uint16_t) ~bit;
+			if (!differs)
+				continue;
+			*t = m->debounce;
+			if (*t)
+				_busy[r] |= bit;
+		}
+		else
+		{
+			// taken once it has differed for the debounce time
+			if (!differs)
+			{
+				*t = 0;
+				_busy[r] &= (uint16_t) ~bit;
+				continue;
+			}
+			_busy[r] |= bit;
+			if (++*t < m->debounce)
+				continue;
+			*t = 0;
+			_busy[r] &= (uint16_t) ~bit;
+		}
+
+		_state[r] ^= bit;
+		changed = true;
+		if (m->handler)
+			m->handler(r, c, (_state[r] & bit) != 0);
+	}
+	return changed;
+}
+
+ISR(TIMER4_OVF_vect)
+{
+	const KeyMatrix* m = _matrix;
+	uint8_t ports[PORTS];
+	boolean changed = false;
+
+	for (uint8_t r = 0; r < m->rows; r++)
+	{
+		*_rowDdr[r] |= _rowMask[r]; // drives a 0
+		_delay_us(KEYS_SETTLE_US);
+		for (uint8_t p = 0; p < _portCount; p++)
+			ports[p] = *_ports[p];
+		*_rowDdr[r] &= (uint8_t) ~_rowMask[r];
+
+		uint16_t raw = 0;
+		for (uint8_t c = 0; c < m->columns; c++)
+			if (!(ports[_colPort[c]] & _colMask[c]))
+				raw |= (uint16_t) (1U << c);
+
+		uint16_t keys = (raw ^ _state[r]) | _busy[r];
+		if (keys && debounce(r, raw, keys))
+			changed = true;
+	}
+
+	if (changed)
+	{
+		buildReport();
+		USB_wakeup();
+	}
+}
+
+boolean Keys_begin(const KeyMatrix* matrix)
+{
+	static boolean plugged;
+
+	if (matrix->rows > KEYS_MAX_ROWS || matrix->columns > KEYS_MAX_COLUMNS)
+		return false;
+	if (!plugged && !USB_plug(&_keys))
+		return false;
+	plugged = true;
+	Keys_end();
+
+	_portCount = 0;
+	for (uint8_t c = 0; c < matrix->columns; c++)
+	{
+		uint8_t pin = matrix->columnPins[c];
+		volatile uint8_t* in = portInputRegister(digitalPinToPort(pin));
+		uint8_t p = 0;
+		while (p < _portCount && _ports[p] != in)
+			p++;
+		if (p == PORTS)
+			return false;
+		if (p == _portCount)
+			_ports[_portCount++] = in;
+		_colPort[c] = p;
+		_colMask[c] = digitalPinToBitMask(pin);
+		pinMode(pin, INPUT_PULLUP);
+	}
+	for (uint8_t r = 0; r < matrix->rows; r++)
+	{
+		uint8_t pin = matrix->rowPins[r];
+		_rowDdr[r]  = portModeRegister(digitalPinToPort(pin));
+		_rowMask[r] = digitalPinToBitMask(pin);
+		pinMode(pin, INPUT);
+		digitalWrite(pin, LOW); // no pull-up: driven low when selected
+	}
+
+	memset((void*) _state, 0, sizeof(_state));
+	memset(_busy, 0, sizeof(_busy));
+	memset(_timer, 0, sizeof(_timer));
+	_matrix = matrix;
+
+	// 1 kHz: CK/64, fast PWM mode counting up to OCR4C
+	TCCR4A = 0;
+	TCCR4C = 0;
+	TCCR4D = 0;
+	TCCR4E = 0;
+	TC4H   = 0;
+	OCR4C  = F_CPU / 64 / 1000 - 1;
+	TC4H   = 0;
+	TCNT4  = 0;
+	TCCR4B = (1 << CS42) | (1 << CS41) | (1 << CS40);
+	TIMSK4 = 1 << TOIE4;
+	return true;
+}
+
+// releases the keys still pressed
+void Keys_end(void)
+{
+	TIMSK4 = 0;
+	TCCR4B = 0;
+	if (!_matrix)
+		return;
+
+	uint8_t sreg = SREG;
+	cli();
+	memset((void*) _state, 0, sizeof(_state));
+	buildReport();
+	SREG = sreg;
+	_matrix = 0;
+}
+
+uint16_t Keys_row(uint8_t row)
+{
+	if (row >= KEYS_MAX_ROWS)
+		return 0;
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t r = _state[row];
+	SREG = sreg;
+	return r;
+}
+
+#endif
+#endif
@@ -0,0 +1,79 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#ifndef KEYS_H
+#define KEYS_H
+
+#include "c_USB.h"
+
+// Key matrix scanner feeding the HID keyboard report
+//
+// Timer4 interrupts at 1 kHz. Each row pin in turn is driven low (the
+// others left floating), then the column pins, with their pull-ups, are
+// read a whole port at a time: a pressed key reads 0. Each key is then
+// debounced on its own, and when a debounced key changes, the keyboard
+// report (modifiers and up to 6 keys, report 2 of the HID descriptor) is
+// rebuilt; it goes to the HID endpoint on the next start of frame. A key
+// is thus reported within 2 ms with KEYS_EAGER (one scan, one frame),
+// plus the debounce time with KEYS_DEFER.
+//
+// Put a diode on each key for more than 2 keys pressed at once. Timer4 is
+// also the PWM of pins 6 and 13 of the Leonardo. The scan needs the CPU:
+// do not call USB_sleep(); a key pressed while the bus is suspended wakes
+// the host up, when it allows it.
+
+#ifndef KEYS_MAX_ROWS
+#define KEYS_MAX_ROWS    8
+#endif
+#ifndef KEYS_MAX_COLUMNS
+#define KEYS_MAX_COLUMNS 16
+#endif
+#ifndef KEYS_SETTLE_US
+#define KEYS_SETTLE_US   3  // between driving a row and reading it
+#endif
+
+// debouncing
+#define KEYS_DEFER 0 // a change is taken once stable for the debounce time
+#define KEYS_EAGER 1 // a change is taken at once, the next one after the debounce time
+
+// from the scan interrupt, when a debounced key changes
+typedef void (*KeysHandler)(uint8_t row, uint8_t column, boolean pressed);
+
+typedef struct
+{
+	uint8_t        rows;
+	uint8_t        columns;
+	const uint8_t* rowPins;    // pin numbers, as for digitalWrite()
+	const uint8_t* columnPins;
+	const uint8_t* keymap;     // HID usages, rows x columns, in program
+	                           // memory; 0 for none, 0xE0-0xE7 for modifiers
+	uint8_t        debounce;   // milliseconds, up to 255
+	uint8_t        algorithm;  // KEYS_DEFER or KEYS_EAGER
+	KeysHandler    handler;    // may be NULL
+} KeyMatrix;
+
+// the matrix must stay valid until Keys_end(); returns false if it is too
+// large or if the start of frame handler cannot be plugged
+boolean  Keys_begin(const KeyMatrix* matrix);
+void     Keys_end  (void);
+
+// debounced state of a row, one bit per column
+uint16_t Keys_row  (uint8_t row);
+
+#endif
@@ -0,0 +1,192 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+
+#include "c_USB.h"
+
+#if defined(USBCON)
+#ifdef MIDI_ENABLED
+
+// USB MIDI 1.0 device with one embedded jack in each direction
+//
+// Events are queued and exchanged on each start of frame: the queued
+// events go to the host packed in bulk packets of up to 16, and the events
+// received from the host are moved to a ring. When the ring is full, the
+// received packets wait in the endpoint banks and the host is held off.
+
+#define QUEUE_SIZE 32 // events, power of 2
+#define QUEUE_MASK (QUEUE_SIZE - 1)
+
+#define MIDI_CS_INTERFACE 0x24
+#define MIDI_CS_ENDPOINT  0x25
+
+static const u8 _midiInterface[] PROGMEM =
+{
+	// interface association
+	8, 11, MIDI_AC_INTERFACE, 2, 0x01, 0x03, 0x00, 0,
+
+	// audio control interface, only there to point to the streaming interface
+	9, USB_INTERFACE_DESCRIPTOR_TYPE, MIDI_AC_INTERFACE, 0, 0, 0x01, 0x01, 0x00, 0,
+	9, MIDI_CS_INTERFACE, 0x01, TOBYTES(0x0100), TOBYTES(9), 1, MIDI_STREAM_INTERFACE,
+
+	// MIDI streaming interface
+	9, USB_INTERFACE_DESCRIPTOR_TYPE, MIDI_STREAM_INTERFACE, 0, 2, 0x01, 0x03, 0x00, 0,
+	7, MIDI_CS_INTERFACE, 0x01, TOBYTES(0x0100), TOBYTES(7 + 6 + 6 + 9 + 9 + 9 + 5 + 9 + 5),
+	6, MIDI_CS_INTERFACE, 0x02, 0x01, 1, 0,         // IN jack 1, embedded
+	6, MIDI_CS_INTERFACE, 0x02, 0x02, 2, 0,         // IN jack 2, external
+	9, MIDI_CS_INTERFACE, 0x03, 0x01, 3, 1, 2, 1, 0, // OUT jack 3, embedded, from jack 2
+	9, MIDI_CS_INTERFACE, 0x03, 0x02, 4, 1, 1, 1, 0, // OUT jack 4, external, from jack 1
+
+	// bulk endpoints, audio class layout (9 bytes), each with its jack
+	9, USB_ENDPOINT_DESCRIPTOR_TYPE, USB_ENDPOINT_OUT(MIDI_ENDPOINT_OUT), USB_ENDPOINT_TYPE_BULK, TOBYTES(64), 0, 0, 0,
+	5, MIDI_CS_ENDPOINT, 0x01, 1, 1,
+	9, USB_ENDPOINT_DESCRIPTOR_TYPE, USB_ENDPOINT_IN (MIDI_ENDPOINT_IN ), USB_ENDPOINT_TYPE_BULK, TOBYTES(64), 0, 0, 0,
+	5, MIDI_CS_ENDPOINT, 0x01, 1, 3,
+};
+
+static MIDIEvent        _tx[QUEUE_SIZE];
+static volatile uint8_t _txHead;
+static volatile uint8_t _txTail; // moved by MIDI_SOF()
+static MIDIEvent        _rx[QUEUE_SIZE];
+static volatile uint8_t _rxHead; // moved by MIDI_SOF()
+static volatile uint8_t _rxTail;
+
+int MIDI_GetInterface(USBClass* c, u8* interfaceNum)
+{
+	(void) c;
+	interfaceNum[0] += 2; // uses 2
+	return USB_SendControl(TRANSFER_PGM, _midiInterface, sizeof(_midiInterface));
+}
+
+// from the host, bank after bank; a full queue leaves the rest in the bank
+static void receive(void)
+{
+	UENUM = MIDI_RX;
+	while (UEINTX & (1<<RXOUTI))
+	{
+		while (UEBCLX >= 4)
+		{
+			uint8_t h = _rxHead;
+			uint8_t next = (h + 1) & QUEUE_MASK;
+			if (next == _rxTail)
+				return;
+			u8* e = (u8*) &_rx[h];
+			for (uint8_t i = 0; i < 4; i++)
+				e[i] = UEDATX;
+			_rxHead = next;
+		}
+		while (UEBCLX) // not a whole event
+			(void) UEDATX;
+		UEINTX = 0x6B; // same as ReleaseRX()
+	}
+}
+
+// called on each start of frame
+void MIDI_SOF(USBClass* c)
+{
+	(void) c;
+	if (!USBGetConfiguration())
+		return;
+
+	// sending goes on even if the program does not read what it receives
+	receive();
+
+	// to the host
+	UENUM = MIDI_TX;
+	uint8_t t = _txTail;
+	if (t == _txHead || !(UEINTX & (1<<RWAL)))
+		return;
+	for (uint8_t n = 0; n < 16 && t != _txHead; n++)
+	{
+		const u8* e = (const u8*) &_tx[t];
+		for (uint8_t i = 0; i < 4; i++)
+			UEDATX = e[i];
+		t = (t + 1) & QUEUE_MASK;
+	}
+	_txTail = t;
+	UEINTX = 0x3A; // same as ReleaseTX()
+}
+
+bool MIDI_send(const MIDIEvent* event)
+{
+	bool ok = false;
+	uint8_t sreg = SREG;
+	cli();
+	uint8_t h = _txHead;
+	uint8_t next = (h + 1) & QUEUE_MASK;
+	if (next != _txTail)
+	{
+		_tx[h] = *event;
+		_txHead = next;
+		ok = true;
+	}
+	SREG = sreg;
+	return ok;
+}
+
+bool MIDI_receive(MIDIEvent* event)
+{
+	bool ok = false;
+	uint8_t sreg = SREG;
+	cli();
+	uint8_t t = _rxTail;
+	if (t != _rxHead)
+	{
+		*event = _rx[t];
+		_rxTail = (t + 1) & QUEUE_MASK;
+		ok = true;
+	}
+	SREG = sreg;
+	return ok;
+}
+
+int MIDI_available(void)
+{
+	return (uint8_t) (_rxHead - _rxTail) & QUEUE_MASK;
+}
+
+// the code index number of a channel message is its status nibble
+static bool channelMessage(u8 status, u8 channel, u8 a, u8 b)
+{
+	MIDIEvent e;
+	e.header  = status >> 4;
+	e.data[0] = (u8) (status | (channel & 0x0F));
+	e.data[1] = a & 0x7F;
+	e.data[2] = b & 0x7F;
+	return MIDI_send(&e);
+}
+
+bool MIDI_noteOn(u8 channel, u8 note, u8 velocity)
+{
+	return channelMessage(0x90, channel, note, velocity);
+}
+
+bool MIDI_noteOff(u8 channel, u8 note, u8 velocity)
+{
+	return channelMessage(0x80, channel, note, velocity);
+}
+
+bool MIDI_controlChange(u8 channel, u8 control, u8 value)
+{
+	return channelMessage(0xB0, channel, control, value);
+}
+
+#endif
+#endif /* if defined(USBCON) */
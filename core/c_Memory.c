@@ -0,0 +1,89 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#include <avr/io.h>
+
+#include "c_Memory.h"
+
+// from the linker script and avr-libc's malloc()
+extern char  __heap_start;
+extern char* __brkval;
+
+void Memory_paint(void) __attribute__ ((naked, used, section (".init3")));
+
+// before the C runtime sets up anything: no stack frame, no call
+void Memory_paint(void)
+{
+	__asm__ volatile
+	(
+		"	ldi  r30, lo8(__heap_start)\n"
+		"	ldi  r31, hi8(__heap_start)\n"
+		"	ldi  r24, %0\n"
+		"	in   r26, __SP_L__\n"
+		"	in   r27, __SP_H__\n"
+		"1:	cp   r30, r26\n"
+		"	cpc  r31, r27\n"
+		"	brsh 2f\n"
+		"	st   Z+, r24\n"
+		"	rjmp 1b\n"
+		"2:\n"
+		:
+		: "i" (MEMORY_PAINT)
+		: "r24", "r26", "r27", "r30", "r31", "memory"
+	);
+}
+
+static char* heapEnd(void)
+{
+	return __brkval ? __brkval : &__heap_start;
+}
+
+size_t Memory_static(void)
+{
+	return (size_t) (&__heap_start - (char*) (uintptr_t) RAMSTART);
+}
+
+size_t Memory_heap(void)
+{
+	return (size_t) (heapEnd() - &__heap_start);
+}
+
+size_t Memory_free(void)
+{
+	return (size_t) ((char*) (uintptr_t) SP - heapEnd());
+}
+
+// first byte above the heap that the stack has written
+static const char* stackLow(void)
+{
+	const char* p = heapEnd();
+	while (p <= (char*) (uintptr_t) SP && *(const uint8_t*) p == MEMORY_PAINT)
+		p++;
+	return p;
+}
+
+size_t Memory_stack(void)
+{
+	return (size_t) ((char*) (uintptr_t) RAMEND - stackLow() + 1);
+}
+
+size_t Memory_unused(void)
+{
+	return (size_t) (stackLow() - heapEnd());
+}
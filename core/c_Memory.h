@@ -0,0 +1,42 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <Arduino.h>
+
+// SRAM budget at run time
+//
+// Linking this module paints the free SRAM (between the static variables
+// and the stack) with MEMORY_PAINT before main() runs; the stack
+// overwrites the paint as it grows, so the deepest it ever went, interrupt
+// handlers included, is where the paint stops. The heap, if malloc() is
+// used, is taken into account. See also "make stack" for the stack usage
+// of each function, computed by the compiler.
+
+#define MEMORY_PAINT 0xC5
+
+size_t Memory_static(void); // .data and .bss
+size_t Memory_heap  (void); // given to malloc() so far
+size_t Memory_free  (void); // between the heap and the stack, now
+size_t Memory_stack (void); // deepest stack since reset
+size_t Memory_unused(void); // smallest free space since reset (paint left)
+
+#endif
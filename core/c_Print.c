@@ -0,0 +1,337 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#include <stdarg.h>
+#include <avr/pgmspace.h>
+
+#include "c_Print.h"
+
+typedef struct
+{
+	PrintWrite write;
+	uint8_t    length;
+	uint8_t    chunk[PRINT_CHUNK];
+} Printer;
+
+// number flags
+#define LEFT  0x01
+#define ZERO  0x02
+#define UPPER 0x04
+
+static const uint32_t _powers[] PROGMEM =
+{
+	1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10,
+};
+
+static void flush(Printer* p)
+{
+	if (p->length)
+		p->write(p->chunk, p->length);
+	p->length = 0;
+}
+
+static void put(Printer* p, char c)
+{
+	p->chunk[p->length++] = (uint8_t) c;
+	if (p->length == PRINT_CHUNK)
+		flush(p);
+}
+
+static void pad(Printer* p, char c, uint8_t n)
+{
+	while (n--)
+		put(p, c);
+}
+
+static char digit(uint8_t d, uint8_t flags)
+{
+	if (d < 10)
+		return (char) ('0' + d);
+	return (char) ((flags & UPPER ? 'A' : 'a') + d - 10);
+}
+
+// the magnitude, most significant digit first, padded to width
+static void number(Printer* p, uint32_t value, boolean negative, uint8_t base, uint8_t width, uint8_t flags)
+{
+	const uint32_t* power = 0;
+	uint8_t shift = 0;
+	char digits[32]; // other bases, least significant first
+	uint8_t n;
+
+	if (base < 2 || base > 36)
+		base = 10;
+
+	if (base == 10)
+	{
+		// skip the powers above the value
+		power = _powers;
+		n = 10;
+		while (n > 1 && value < pgm_read_dword(power))
+		{
+			power++;
+			n--;
+		}
+	}
+	else if (!(base & (base - 1)))
+	{
+		while ((1 << ++shift) != base)
+			;
+		n = 1;
+		while (n * shift < 32 && value >> (n * shift))
+			n++;
+	}
+	else
+	{
+		n = 0;
+		do
+		{
+			digits[n++] = digit((uint8_t) (value % base), flags);
+			value /= base;
+		} while (value);
+	}
+
+	uint8_t length = (uint8_t) (n + negative);
+	uint8_t fill = width > length ? (uint8_t) (width - length) : 0;
+	if (!(flags & (LEFT | ZERO)))
+		pad(p, ' ', fill);
+	if (negative)
+		put(p, '-');
+	if ((flags & (LEFT | ZERO)) == ZERO)
+		pad(p, '0', fill);
+
+	if (power)
+	{
+		for (; n > 1; n--, power++)
+		{
+			uint32_t pw = pgm_read_dword(power);
+			char d = '0';
+			while (value >= pw)
+			{
+				value -= pw;
+				d++;
+			}
+			put(p, d);
+		}
+		put(p, (char) ('0' + value));
+	}
+	else if (shift)
+	{
+		while (n--)
+			put(p, digit((uint8_t) (value >> (n * shift)) & (uint8_t) (base - 1), flags));
+	}
+	else
+	{
+		while (n--)
+			put(p, digits[n]);
+	}
+
+	if (flags & LEFT)
+		pad(p, ' ', fill);
+}
+
+static void snumber(Printer* p, int32_t value, uint8_t base, uint8_t width, uint8_t flags)
+{
+	uint32_t magnitude = value < 0 ? -(uint32_t) value : (uint32_t) value;
+	number(p, magnitude, value < 0, base, width, flags);
+}
+
+static char next(const char** s, boolean pgm)
+{
+	char c = pgm ? (char) pgm_read_byte(*s) : **s;
+	(*s)++;
+	return c;
+}
+
+static void string(Printer* p, const char* s, boolean pgm, uint8_t width, uint8_t flags)
+{
+	uint8_t fill = 0;
+	if (width)
+	{
+		const char* e = s;
+		uint8_t length = 0;
+		while (length < width && next(&e, pgm))
+			length++;
+		fill = (uint8_t) (width - length);
+	}
+
+	if (!(flags & LEFT))
+		pad(p, ' ', fill);
+	char c;
+	while ((c = next(&s, pgm)))
+		put(p, c);
+	if (flags & LEFT)
+		pad(p, ' ', fill);
+}
+
+static void format(Printer* p, const char* f, boolean pgm, va_list args)
+{
+	char c;
+	while ((c = next(&f, pgm)))
+	{
+		if (c != '%')
+		{
+			put(p, c);
+			continue;
+		}
+
+		uint8_t flags = 0;
+		uint8_t width = 0;
+		for (;;)
+		{
+			c = next(&f, pgm);
+			if (c == '-')
+				flags |= LEFT;
+			else if (c == '0')
+				flags |= ZERO;
+			else
+				break;
+		}
+		for (; c >= '0' && c <= '9'; c = next(&f, pgm))
+			width = (uint8_t) (width * 10 + c - '0');
+		boolean isLong = c == 'l';
+		if (isLong)
+			c = next(&f, pgm);
+
+		uint8_t base;
+		switch (c)
+		{
+		case 'd':
+		case 'i':
+			snumber(p, isLong ? (int32_t) va_arg(args, long) : va_arg(args, int), 10, width, flags);
+			break;
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+		case 'b':
+			base = c == 'u' ? 10 : c == 'o' ? 8 : c == 'b' ? 2 : 16;
+			if (c == 'X')
+				flags |= UPPER;
+			number(p, isLong ? (uint32_t) va_arg(args, unsigned long) : va_arg(args, unsigned int),
+			       false, base, width, flags);
+			break;
+		case 'c':
+			put(p, (char) va_arg(args, int));
+			break;
+		case 's':
+		case 'S':
+			string(p, va_arg(args, const char*), c == 'S', width, flags);
+			break;
+		case '\0': // '%' ending the format
+			return;
+		default:
+			put(p, c);
+		}
+	}
+}
+
+void Print_string(PrintWrite write, const char* s)
+{
+	Printer p = { write, 0, { 0 } };
+	string(&p, s, false, 0, 0);
+	flush(&p);
+}
+
+void Print_string_P(PrintWrite write, const char* s)
+{
+	Printer p = { write, 0, { 0 } };
+	string(&p, s, true, 0, 0);
+	flush(&p);
+}
+
+void Print_unsigned(PrintWrite write, uint32_t value, uint8_t base)
+{
+	Printer p = { write, 0, { 0 } };
+	number(&p, value, false, base, 0, 0);
+	flush(&p);
+}
+
+void Print_signed(PrintWrite write, int32_t value, uint8_t base)
+{
+	Printer p = { write, 0, { 0 } };
+	snumber(&p, value, base, 0, 0);
+	flush(&p);
+}
+
+void Print_fixed(PrintWrite write, int32_t value, uint8_t bits, uint8_t decimals)
+{
+	Printer p = { write, 0, { 0 } };
+	uint32_t magnitude = value < 0 ? -(uint32_t) value : (uint32_t) value;
+	uint32_t mask = ((uint32_t) 1 << bits) - 1;
+
+	number(&p, magnitude >> bits, value < 0, 10, 0, 0);
+	if (decimals)
+		put(&p, '.');
+	// the fraction times ten: the integer part is the next decimal
+	uint32_t fraction = magnitude & mask;
+	while (decimals--)
+	{
+		fraction *= 10;
+		put(&p, (char) ('0' + (fraction >> bits)));
+		fraction &= mask;
+	}
+	flush(&p);
+}
+
+void Print_hexdump(PrintWrite write, const void* data, size_t size)
+{
+	Printer p = { write, 0, { 0 } };
+	const uint8_t* bytes = (const uint8_t*) data;
+	for (size_t i = 0; i < size; i++)
+	{
+		if (!(i & 15))
+		{
+			if (i)
+			{
+				put(&p, '\r');
+				put(&p, '\n');
+			}
+			number(&p, (uint32_t) i, false, 16, 4, ZERO);
+			put(&p, ':');
+		}
+		put(&p, ' ');
+		number(&p, bytes[i], false, 16, 2, ZERO);
+	}
+	if (size)
+	{
+		put(&p, '\r');
+		put(&p, '\n');
+	}
+	flush(&p);
+}
+
+void Print_format(PrintWrite write, const char* f, ...)
+{
+	Printer p = { write, 0, { 0 } };
+	va_list args;
+	va_start(args, f);
+	format(&p, f, false, args);
+	va_end(args);
+	flush(&p);
+}
+
+void Print_format_P(PrintWrite write, const char* f, ...)
+{
+	Printer p = { write, 0, { 0 } };
+	va_list args;
+	va_start(args, f);
+	format(&p, f, true, args);
+	va_end(args);
+	flush(&p);
+}
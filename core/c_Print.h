@@ -0,0 +1,59 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#ifndef PRINT_H
+#define PRINT_H
+
+#include <Arduino.h>
+
+// Formatted output without the heap nor sprintf()
+//
+// The text is written to the stream as it is produced, through a chunk of
+// PRINT_CHUNK bytes on the stack, so that the stream (CDC endpoint, UART
+// ring) is called once per chunk rather than once per byte. Decimal digits
+// come from subtracting powers of ten, most significant first: there is no
+// division, and no digit buffer, in bases 2, 8, 10 and 16.
+
+#ifndef PRINT_CHUNK
+#define PRINT_CHUNK 16
+#endif
+
+// same as UART_writeBytes() and Serial_writeBytes()
+typedef size_t (*PrintWrite)(const uint8_t* data, size_t size);
+
+void Print_string  (PrintWrite write, const char* s);
+void Print_string_P(PrintWrite write, const char* s); // in program memory
+
+// base from 2 to 36
+void Print_unsigned(PrintWrite write, uint32_t value, uint8_t base);
+void Print_signed  (PrintWrite write, int32_t  value, uint8_t base);
+
+// value / 2^bits (bits up to 28) with the given number of decimals,
+// truncated; Print_fixed(w, 0x0180, 8, 2) prints "1.50"
+void Print_fixed   (PrintWrite write, int32_t value, uint8_t bits, uint8_t decimals);
+
+// 16 bytes per line, after their offset: "0010: 0a 00 ff ..."
+void Print_hexdump (PrintWrite write, const void* data, size_t size);
+
+// printf() subset: %d %i %u %x %X %o %b %c %s %S (string in program
+// memory) and %%; flags '-' and '0', a width, and 'l' for 32-bit integers
+void Print_format  (PrintWrite write, const char* format, ...);
+void Print_format_P(PrintWrite write, const char* format, ...);
+
+#endif
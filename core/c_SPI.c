@@ -0,0 +1,312 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "c_SPI.h"
+
+#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define SS_BIT   0
+#define SCK_BIT  1
+#define MOSI_BIT 2
+#define MISO_BIT 3
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+#define SS_BIT   2
+#define MOSI_BIT 3
+#define MISO_BIT 4
+#define SCK_BIT  5
+#endif
+
+// SPI pins unknown for other MCUs: nothing to link
+#ifdef SS_BIT
+
+// what the next byte of the transaction is
+#define STATE_COMMAND 0
+#define STATE_READ    1 // a register went out
+#define STATE_WRITE   2 // a register value
+#define STATE_LENGTH  3 // of a stream frame
+#define STATE_DATA    4 // stream bytes
+#define STATE_FETCHED 5 // the fetch length went out
+#define STATE_FETCH   6 // a fetched byte went out
+#define STATE_IGNORE  7 // until SS goes high
+
+static volatile uint8_t*  _registers;
+static uint8_t            _count;
+static SPIRegisterHandler _handler;
+
+static uint8_t            _rx[2][SPI_BUFFER_SIZE];
+static volatile uint8_t   _rxLength[2];
+static volatile uint8_t   _rxFill;    // filled by the interrupt
+static volatile uint8_t   _rxReady;   // the other one is full, for SPI_next()
+static volatile uint16_t  _overflows;
+
+static uint8_t            _tx[2][SPI_BUFFER_SIZE];
+static volatile uint8_t   _txLength[2];
+static volatile uint8_t   _txSend;    // sent by the interrupt
+static volatile uint8_t   _txPos;
+static volatile uint8_t   _txWriting; // SPI_write() is filling the other one
+
+// transaction, only used by the interrupts
+static uint8_t            _state;
+static uint8_t            _reg;       // next register
+static uint8_t            _left;      // bytes of the frame, or to fetch
+
+void SPI_begin(uint8_t mode, volatile uint8_t* registers, uint8_t count,
+               SPIRegisterHandler handler)
+{
+	SPI_end();
+	_registers = registers;
+	_count     = !registers ? 0 : count > SPI_REGISTERS ? SPI_REGISTERS : count;
+	_handler   = handler;
+
+	_rxLength[0] = _rxLength[1] = 0;
+	_rxFill = _rxReady = 0;
+	_overflows = 0;
+	_txLength[0] = _txLength[1] = 0;
+	_txSend = _txPos = 0;
+
+	// a master already in a transaction: wait for its end
+	_state = PINB & (1 << SS_BIT) ? STATE_COMMAND : STATE_IGNORE;
+
+	DDRB &= (uint8_t) ~((1 << SS_BIT) | (1 << SCK_BIT) | (1 << MOSI_BIT));
+	DDRB |= 1 << MISO_BIT;
+	PCMSK0 |= 1 << SS_BIT;
+	PCIFR = 1 << PCIF0;
+	PCICR |= 1 << PCIE0;
+	SPCR = (uint8_t) ((1 << SPE) | (1 << SPIE) | (mode & 3) << CPHA);
+	(void) SPSR;
+	(void) SPDR; // clears SPIF
+}
+
+void SPI_end(void)
+{
+	SPCR = 0;
+	PCMSK0 &= (uint8_t) ~(1 << SS_BIT);
+	if (!PCMSK0)
+		PCICR &= (uint8_t) ~(1 << PCIE0);
+	DDRB &= (uint8_t) ~(1 << MISO_BIT);
+}
+
+// the buffer being filled goes to SPI_next(); the other one must be free
+static inline void promote(void)
+{
+	_rxFill ^= 1;
+	_rxReady = 1;
+}
+
+uint8_t* SPI_next(uint8_t* size)
+{
+	if (!_rxReady)
+		return 0;
+	uint8_t b = _rxFill ^ 1;
+	*size = _rxLength[b];
+	return _rx[b];
+}
+
+// hand the buffer returned by SPI_next() back to the interrupt
+void SPI_release(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	_rxLength[_rxFill ^ 1] = 0;
+	_rxReady = 0;
+	if (_rxLength[_rxFill] == SPI_BUFFER_SIZE)
+		promote();
+	SREG = sreg;
+}
+
+uint8_t SPI_flush(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint8_t n = 0;
+	if (!_rxReady && (n = _rxLength[_rxFill]))
+		promote();
+	SREG = sreg;
+	return n;
+}
+
+// bytes in the buffer being filled
+uint8_t SPI_pending(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint8_t n = _rxLength[_rxFill];
+	SREG = sreg;
+	return n;
+}
+
+uint8_t SPI_write(const uint8_t* data, uint8_t size)
+{
+	_txWriting = 1;
+	uint8_t fill = _txSend ^ 1;
+	uint8_t length = _txLength[fill];
+	if (size > SPI_BUFFER_SIZE - length)
+		size = (uint8_t) (SPI_BUFFER_SIZE - length);
+	memcpy(_tx[fill] + length, data, size);
+	__asm__ __volatile__ ("" ::: "memory"); // the bytes, then the length
+	_txLength[fill] = (uint8_t) (length + size);
+	_txWriting = 0;
+	return size;
+}
+
+uint16_t SPI_overflows(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t r = _overflows;
+	SREG = sreg;
+	return r;
+}
+
+static inline uint8_t registerValue(uint8_t r)
+{
+	return r < _count ? _registers[r] : 0;
+}
+
+static inline void store(uint8_t c)
+{
+	uint8_t fill = _rxFill;
+	uint8_t length = _rxLength[fill];
+	if (length == SPI_BUFFER_SIZE)
+	{
+		_overflows++; // both buffers are full
+		return;
+	}
+	_rx[fill][length++] = c;
+	_rxLength[fill] = length;
+	if (length == SPI_BUFFER_SIZE && !_rxReady)
+		promote();
+}
+
+static inline uint8_t space(void)
+{
+	return (uint8_t) (SPI_BUFFER_SIZE - _rxLength[_rxFill] + (_rxReady ? 0 : SPI_BUFFER_SIZE));
+}
+
+// a fetch starts: the buffer being sent is switched once it is over
+static inline uint8_t fetchLength(void)
+{
+	uint8_t s = _txSend;
+	if (_txPos == _txLength[s] && _txLength[s ^ 1] && !_txWriting)
+	{
+		_txLength[s] = 0;
+		_txSend = s ^= 1;
+		_txPos = 0;
+	}
+	return (uint8_t) (_txLength[s] - _txPos);
+}
+
+static inline void command(uint8_t c)
+{
+	if (c < SPI_STREAM)
+	{
+		_reg = c & (SPI_REGISTERS - 1);
+		if (c & SPI_WRITE)
+			_state = STATE_WRITE;
+		else
+		{
+			SPDR = registerValue(_reg);
+			_state = STATE_READ;
+		}
+	}
+	else if (c == SPI_STREAM)
+		_state = STATE_LENGTH;
+	else if (c == SPI_FETCH)
+	{
+		SPDR = _left = fetchLength();
+		_state = STATE_FETCHED;
+	}
+	else
+	{
+		if (c == SPI_SPACE)
+			SPDR = space();
+		_state = STATE_IGNORE;
+	}
+}
+
+// one byte of the transaction; the reply to the next one is loaded here
+static void transfer(void)
+{
+	uint8_t c = SPDR;
+	switch (_state)
+	{
+	case STATE_COMMAND:
+		command(c);
+		break;
+	case STATE_READ:
+		SPDR = registerValue(++_reg);
+		break;
+	case STATE_WRITE:
+		if (_reg < _count)
+		{
+			_registers[_reg] = c;
+			if (_handler)
+				_handler(_reg, c);
+		}
+		_reg++;
+		break;
+	case STATE_LENGTH:
+		_left = c;
+		_state = c ? STATE_DATA : STATE_IGNORE;
+		break;
+	case STATE_DATA:
+		store(c);
+		if (!--_left)
+			_state = STATE_IGNORE;
+		break;
+	case STATE_FETCH:
+		_txPos++;
+		if (!--_left)
+		{
+			_state = STATE_IGNORE;
+			break;
+		}
+		// fall through
+	case STATE_FETCHED:
+		if (_left)
+		{
+			SPDR = _tx[_txSend][_txPos];
+			_state = STATE_FETCH;
+		}
+		else
+			_state = STATE_IGNORE;
+		break;
+	}
+}
+
+ISR(SPI_STC_vect)
+{
+	transfer();
+}
+
+// SS: the end of a transaction; the next byte is a command
+ISR(PCINT0_vect)
+{
+	if (!(PINB & (1 << SS_BIT)))
+		return;
+	// this interrupt comes first: the last byte may still be waiting
+	if (SPSR & (1 << SPIF))
+		transfer();
+	_state = STATE_COMMAND;
+	SPDR = 0;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#ifndef SPI_H
+#define SPI_H
+
+#include <Arduino.h>
+
+// Interrupt-driven SPI slave
+//
+// The master selects the board (SS low), sends a command byte, then the
+// bytes of the command; the transaction ends when SS goes back high, which
+// a pin change interrupt watches. Each byte is handled by its own SPI
+// interrupt, so the other interrupts keep running between bytes. Commands:
+//
+//     SPI_READ | r      registers r, r + 1... are sent back
+//     SPI_WRITE | r     the next bytes are written to registers r, r + 1...
+//     SPI_STREAM        then a length n (1-255) and n bytes for the stream
+//     SPI_FETCH         the slave sends a length n, then n bytes written
+//                       with SPI_write() (the master may clock fewer)
+//     SPI_SPACE         the slave sends how many stream bytes it can take
+//
+// The SPI holds one received byte: the interrupt of a byte must have run
+// before the next one is complete, and a reply byte is loaded by the
+// interrupt of the byte before it. The master must therefore leave about
+// 5 us between bytes (SCK up to F_CPU / 4), plus the longest interrupt
+// handler of the program (USB ones included), or slow SCK down to the
+// same effect.
+//
+// Stream bytes are gathered into two alternating buffers of
+// SPI_BUFFER_SIZE bytes: the interrupt fills one while the program reads
+// the other, in place, with SPI_next() and SPI_release(). Bytes that find
+// both buffers full are dropped and counted (SPI_overflows()); SPI_SPACE
+// lets the master avoid that. SPI_write() queues bytes for SPI_FETCH the
+// same way, through two buffers.
+//
+// On the Leonardo, SS (PB0) is the RX LED, and is on the header of the
+// Micro; the SPI keeps it an input whatever the LED code does. The Mega
+// uses the same pins of port B, the Uno PB2 to PB5; on other MCUs the
+// module is left out. The PCINT0 interrupt is taken (not available to
+// c_Capture.h in pin change mode).
+
+#define SPI_READ   0x00
+#define SPI_WRITE  0x40
+#define SPI_STREAM 0x80
+#define SPI_FETCH  0x81
+#define SPI_SPACE  0x82
+
+#define SPI_REGISTERS   64 // at most, numbered 0-63
+#define SPI_BUFFER_SIZE 64 // one USB packet
+
+// called from the interrupt for each register the master writes
+typedef void (*SPIRegisterHandler)(uint8_t reg, uint8_t value);
+
+// mode 0-3 (CPOL, CPHA) as for the master; registers may be NULL, the
+// handler too
+void     SPI_begin    (uint8_t mode, volatile uint8_t* registers, uint8_t count,
+                       SPIRegisterHandler handler);
+void     SPI_end      (void);
+
+// the full stream buffer, if any, and the number of bytes in it
+uint8_t* SPI_next     (uint8_t* size);
+void     SPI_release  (void);
+
+// makes the bytes of the buffer being filled available to SPI_next(), if
+// the other buffer is free; returns the number of bytes moved
+uint8_t  SPI_flush    (void);
+uint8_t  SPI_pending  (void);
+
+// queues up to size bytes for the master; returns how many fitted
+uint8_t  SPI_write    (const uint8_t* data, uint8_t size);
+uint16_t SPI_overflows(void);
+
+#endif
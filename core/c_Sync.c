@@ -0,0 +1,142 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#include <avr/interrupt.h>
+
+#include "c_USB.h"
+#include "c_Sync.h"
+
+#if defined(USBCON)
+
+#define NOMINAL   64000UL        // microseconds per frame, times 64
+#define MAX_ERROR (NOMINAL / 100) // rates further than 1% are measurement errors
+#define MAX_DELTA 20000L         // microseconds, keeps the scaling in 32 bits
+
+static volatile boolean _started;
+static volatile boolean _locked;
+static u16              _lastFrame;    // 11 bits
+static volatile u32     _frames;       // of the last start of frame
+static volatile u32     _sofMicros;    // local time of the last start of frame
+static u32              _anchorFrames; // start of the rate window
+static u32              _anchorMicros;
+static volatile u32     _rate  = NOMINAL;  // local microseconds per frame, times 64
+static volatile u32     _scale = 65536;    // host microseconds per local one, times 65536
+
+static void Sync_SOF(USBClass* c)
+{
+	(void) c;
+	u32 now = micros();
+	u16 f = USB_FrameNumber();
+
+	if (!_started)
+	{
+		_started = true;
+		_frames = f;
+		_anchorFrames = f;
+		_anchorMicros = now;
+	}
+	else
+	{
+		u32 n = (u16) (f - _lastFrame) & 0x7FF;
+		u32 gap = now - _sofMicros;
+		_frames += n;
+		// frames missed while suspended, the 11 bits having wrapped
+		// around: counted from the local clock, out of the rate window
+		if (gap > 1000000UL)
+		{
+			u32 expected = (gap + 500) / 1000;
+			if (expected > n)
+				_frames += (expected - n + 1024) & ~0x7FFUL;
+			_anchorFrames = _frames;
+			_anchorMicros = now;
+		}
+	}
+	_lastFrame = f;
+	_sofMicros = now;
+
+	u32 frames = _frames - _anchorFrames;
+	if (frames < SYNC_WINDOW)
+		return;
+	u32 measured = ((now - _anchorMicros) << 6) / frames;
+	_anchorFrames = _frames;
+	_anchorMicros = now;
+	if (measured < NOMINAL - MAX_ERROR || measured > NOMINAL + MAX_ERROR)
+		return;
+	_rate  = _locked ? (u32) ((int32_t) _rate + ((int32_t) measured - (int32_t) _rate) / 4) : measured;
+	_scale = NOMINAL * 65536 / _rate;
+	_locked = true;
+}
+
+static USBClass _sync = { 0, 0, 0, 0, 0, 0, Sync_SOF, 0, 0, 0 };
+
+boolean Sync_begin(void)
+{
+	return USB_plug(&_sync) != 0;
+}
+
+boolean Sync_locked(void)
+{
+	return _locked;
+}
+
+uint32_t Sync_frames(void)
+{
+	u8 sreg = SREG;
+	cli();
+	u32 r = _frames;
+	SREG = sreg;
+	return r;
+}
+
+uint32_t Sync_stamp(uint32_t local)
+{
+	u8 sreg = SREG;
+	cli();
+	u32 frames = _frames;
+	u32 sof    = _sofMicros;
+	u32 scale  = _scale;
+	SREG = sreg;
+
+	int32_t delta = (int32_t) (local - sof);
+	if (delta > MAX_DELTA)
+		delta = MAX_DELTA;
+	else if (delta < -MAX_DELTA)
+		delta = -MAX_DELTA;
+	// scale is close to 65536: the product stays within 31 bits
+	int32_t host = (int32_t) (((int32_t) scale * delta) / 65536);
+	return frames * 1000 + (u32) host;
+}
+
+uint32_t Sync_micros(void)
+{
+	return Sync_stamp(micros());
+}
+
+int16_t Sync_ppm(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	u32 rate = _rate;
+	SREG = sreg;
+
+	// (rate - NOMINAL) / NOMINAL * 1000000
+	return (int16_t) (((int32_t) rate - (int32_t) NOMINAL) * 125 / 8);
+}
+
+#endif
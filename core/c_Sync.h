@@ -0,0 +1,50 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <Arduino.h>
+
+// Host time base, from the USB start of frame
+//
+// The host starts a frame every millisecond, on its own clock. On each
+// start of frame, the frame number is latched with micros(), and the rate
+// of the local clock is measured against the frames every SYNC_WINDOW
+// frames, then smoothed. Between frames, the local microseconds are scaled
+// by that rate. The time is in microseconds since frame 0; the low 11 bits
+// of Sync_frames() are the USB frame number, so that the host can map the
+// timestamps of all its boards to its own clock. The latency of the
+// interrupt is included, the same for every board running the same code.
+//
+// The microseconds wrap around every 71 minutes, the frames every 49 days.
+
+#define SYNC_WINDOW 1024 // frames
+
+boolean  Sync_begin (void);    // plugs the start of frame handler
+boolean  Sync_locked(void);    // whether the rate has been measured
+uint32_t Sync_frames(void);    // frames since frame 0 (host milliseconds)
+uint32_t Sync_micros(void);    // host time now
+int16_t  Sync_ppm   (void);    // local clock error, parts per million
+
+// host time of a micros() value, taken at most 20 ms away from the last
+// start of frame (in an interrupt, when a sample is taken)
+uint32_t Sync_stamp (uint32_t local);
+
+#endif
@@ -0,0 +1,190 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/interrupt.h>
+
+#include "c_TWI.h"
+
+// TWCR values
+#define NEXT  ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define START (NEXT | (1 << TWSTA))
+#define ACK   (NEXT | (1 << TWEA))
+
+static TWITransaction* volatile _head; // being carried out
+static TWITransaction*          _tail;
+static uint8_t                  _index;   // in the current buffer
+static uint8_t                  _reading;
+
+void TWI_begin(uint32_t frequency)
+{
+	TWI_end();
+
+	// SCL = F_CPU / (16 + 2 * TWBR * 4^TWPS)
+	// 0, or beyond the fastest the TWI can go (F_CPU / 16): the fastest
+	uint32_t twbr = frequency == 0 || frequency >= F_CPU / 16 ? 0 : (F_CPU / frequency - 16) / 2;
+	uint8_t  twps = 0;
+	while (twbr > 255 && twps < 3)
+	{
+		twbr /= 4;
+		twps++;
+	}
+	TWSR = twps;
+	TWBR = twbr > 255 ? 255 : (uint8_t) twbr;
+
+	digitalWrite(SDA, HIGH);
+	digitalWrite(SCL, HIGH);
+	TWCR = 1 << TWEN;
+}
+
+// drops the queued transactions (their status becomes TWI_BUS_ERROR)
+void TWI_end(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	TWCR = 0;
+	for (TWITransaction* t = _head; t; t = t->next)
+		t->status = TWI_BUS_ERROR;
+	_head = NULL;
+	_tail = NULL;
+	SREG = sreg;
+
+	digitalWrite(SDA, LOW);
+	digitalWrite(SCL, LOW);
+}
+
+uint8_t TWI_submit(TWITransaction* t)
+{
+	if (t->status == TWI_PENDING)
+		return 0;
+	t->status = TWI_PENDING;
+	t->next   = NULL;
+
+	uint8_t sreg = SREG;
+	cli();
+	if (_head)
+	{
+		_tail->next = t;
+	}
+	else
+	{
+		_head = t;
+		// the stop condition of the last transaction may still be going out
+		while (TWCR & (1 << TWSTO));
+		TWCR = START;
+	}
+	_tail = t;
+	SREG = sreg;
+	return 1;
+}
+
+uint8_t TWI_busy(void)
+{
+	return _head != NULL;
+}
+
+uint8_t TWI_wait(TWITransaction* t)
+{
+	while (t->status == TWI_PENDING);
+	return t->status;
+}
+
+// ends the current transaction and goes on with the next one, if any
+static void finish(uint8_t status)
+{
+	TWITransaction* t = _head;
+	_head = t->next;
+	if (!_head)
+		_tail = NULL;
+
+	// the bus is not ours to stop after losing arbitration; a start
+	// condition after a stop condition is sent as soon as the bus is free
+	uint8_t twcr = (1 << TWINT) | (1 << TWEN);
+	if (status != TWI_ARBITRATION)
+		twcr |= 1 << TWSTO;
+	if (_head)
+		twcr |= (1 << TWSTA) | (1 << TWIE);
+	TWCR = twcr;
+
+	t->status = status;
+	if (t->done)
+		t->done(t);
+}
+
+ISR(TWI_vect)
+{
+	TWITransaction* t = _head;
+	switch (TWSR & 0xF8)
+	{
+	case 0x08: // start
+	case 0x10: // repeated start
+		// write first unless there is nothing to write
+		_reading = (TWSR & 0xF8) == 0x10 || (t->writeLength == 0 && t->readLength != 0);
+		_index = 0;
+		TWDR = (uint8_t) (t->address << 1 | _reading);
+		TWCR = NEXT;
+		break;
+
+	case 0x30: // data not acknowledged
+		if (_index < t->writeLength)
+		{
+			finish(TWI_NACK_DATA);
+			break;
+		}
+		// fall through: the last byte may be refused
+	case 0x18: // address acknowledged (write)
+	case 0x28: // data acknowledged
+		if (_index < t->writeLength)
+		{
+			TWDR = t->write[_index++];
+			TWCR = NEXT;
+		}
+		else if (t->readLength)
+			TWCR = START;
+		else
+			finish(TWI_OK);
+		break;
+
+	case 0x20: // address not acknowledged (write)
+	case 0x48: // address not acknowledged (read)
+		finish(TWI_NACK_ADDRESS);
+		break;
+
+	case 0x38: // arbitration lost
+		finish(TWI_ARBITRATION);
+		break;
+
+	case 0x40: // address acknowledged (read)
+		// the last byte is not acknowledged
+		TWCR = t->readLength > 1 ? ACK : NEXT;
+		break;
+
+	case 0x50: // data received, acknowledged
+		t->read[_index++] = TWDR;
+		TWCR = _index + 1 < t->readLength ? ACK : NEXT;
+		break;
+
+	case 0x58: // last byte received
+		t->read[_index] = TWDR;
+		finish(TWI_OK);
+		break;
+
+	default:
+		finish(TWI_BUS_ERROR);
+		break;
+	}
+}
@@ -0,0 +1,71 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef TWI_H
+#define TWI_H
+
+#include <Arduino.h>
+
+// Asynchronous I2C (TWI) master
+//
+// Transactions are queued and carried out one after the other from the TWI
+// interrupt: TWI_submit() returns at once and the callback of the
+// transaction is called (from the interrupt) once it is over. A transaction
+// writes writeLength bytes, then reads readLength bytes after a repeated
+// start; either length may be 0.
+//
+// Transactions belong to the caller, who must keep them (and their
+// buffers) alive until their status is no longer TWI_PENDING.
+
+// status of a transaction
+#define TWI_OK           0
+#define TWI_NACK_ADDRESS 1 // no device answered
+#define TWI_NACK_DATA    2 // the device refused a byte
+#define TWI_ARBITRATION  3 // another master took the bus
+#define TWI_BUS_ERROR    4
+#define TWI_PENDING      0xFF
+
+typedef struct TWITransaction TWITransaction;
+typedef void (*TWICallback)(TWITransaction* transaction);
+
+struct TWITransaction
+{
+	uint8_t          address;     // 7-bit device address
+	const uint8_t*   write;
+	uint8_t          writeLength;
+	uint8_t*         read;
+	uint8_t          readLength;
+	TWICallback      done;        // may be NULL
+	void*            data;        // free for the caller
+	volatile uint8_t status;
+	TWITransaction*  next;
+};
+
+// frequency in Hz, usually 100000 or 400000, at most F_CPU / 16 (0 also
+// gives the fastest clock); enables the internal pull-ups
+void    TWI_begin (uint32_t frequency);
+void    TWI_end   (void);
+
+// returns 0 if the transaction is already queued
+uint8_t TWI_submit(TWITransaction* transaction);
+uint8_t TWI_busy  (void);
+
+// waits for the transaction to be over and returns its status
+uint8_t TWI_wait  (TWITransaction* transaction);
+
+#endif
@@ -0,0 +1,187 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "c_Task.h"
+
+#define TASK_TIMED 0x01 // has a deadline
+#define TASK_ONCE  0x02 // freed after it runs
+
+typedef struct
+{
+	TaskFunc         func;
+	uint32_t         deadline;
+	uint16_t         period;
+	uint8_t          flags;
+	volatile uint8_t posted;
+	TaskStats        stats;
+} Task;
+
+static Task             _tasks[TASK_MAX];
+static volatile uint8_t _posted; // some task has been posted
+static uint32_t         _idle;
+
+static inline boolean reached(uint32_t now, uint32_t deadline)
+{
+	return (int32_t) (now - deadline) >= 0;
+}
+
+static int8_t add(TaskFunc func, uint8_t flags, uint16_t period, uint16_t delay)
+{
+	for (uint8_t i = 0; i < TASK_MAX; i++)
+	{
+		Task* t = &_tasks[i];
+		if (t->func)
+			continue;
+		t->deadline = millis() + delay;
+		t->period   = period;
+		t->flags    = flags;
+		t->posted   = 0;
+		t->stats.runs    = 0;
+		t->stats.missed  = 0;
+		t->stats.maxTime = 0;
+		t->stats.time    = 0;
+		t->func     = func;
+		return (int8_t) i;
+	}
+	return -1;
+}
+
+// run func every period milliseconds, the first time in delay milliseconds
+int8_t Task_every(TaskFunc func, uint16_t period, uint16_t delay)
+{
+	return add(func, TASK_TIMED, period, delay);
+}
+
+// run func once, in delay milliseconds
+int8_t Task_after(TaskFunc func, uint16_t delay)
+{
+	return add(func, TASK_TIMED | TASK_ONCE, 0, delay);
+}
+
+// run func each time it is posted
+int8_t Task_event(TaskFunc func)
+{
+	return add(func, 0, 0, 0);
+}
+
+// make the task due now; can be called from an interrupt
+void Task_post(int8_t id)
+{
+	if (id < 0 || id >= TASK_MAX)
+		return;
+	_tasks[id].posted = 1;
+	_posted = 1;
+}
+
+void Task_cancel(int8_t id)
+{
+	if (id >= 0 && id < TASK_MAX)
+		_tasks[id].func = 0;
+}
+
+const TaskStats* Task_stats(int8_t id)
+{
+	if (id < 0 || id >= TASK_MAX)
+		return 0;
+	return &_tasks[id].stats;
+}
+
+// total time spent sleeping, in microseconds
+uint32_t Task_idle(void)
+{
+	return _idle;
+}
+
+static void run(Task* t, uint32_t now)
+{
+	TaskFunc func = t->func;
+
+	t->posted = 0;
+	if (t->flags & TASK_ONCE)
+	{
+		t->func = 0; // the task may schedule itself again
+	}
+	else if ((t->flags & TASK_TIMED) && reached(now, t->deadline))
+	{
+		// keep the phase, unless whole periods have been missed
+		t->deadline += t->period;
+		if (reached(now, t->deadline))
+		{
+			t->stats.missed++;
+			t->deadline = now + t->period;
+		}
+	}
+
+	uint32_t start = micros();
+	func();
+	uint32_t elapsed = micros() - start;
+
+	t->stats.runs++;
+	t->stats.time += elapsed;
+	if (elapsed > t->stats.maxTime)
+		t->stats.maxTime = elapsed > 0xFFFF ? 0xFFFF : (uint16_t) elapsed;
+}
+
+// run the most urgent due task, or sleep until the next interrupt
+void Task_loop(void)
+{
+	_posted = 0;
+
+	uint32_t now = millis();
+	Task* next = 0;
+	for (uint8_t i = 0; i < TASK_MAX; i++)
+	{
+		Task* t = &_tasks[i];
+		if (!t->func)
+			continue;
+		if (t->posted)
+		{
+			next = t;
+			break;
+		}
+		if (!(t->flags & TASK_TIMED) || !reached(now, t->deadline))
+			continue;
+		if (!next || (int32_t) (t->deadline - next->deadline) < 0)
+			next = t;
+	}
+
+	if (next)
+	{
+		run(next, now);
+		return;
+	}
+
+	// a task posted after the scan must not wait for the next interrupt:
+	// interrupts stay disabled until sleep_cpu(), the instruction following
+	// sei() is always executed before any pending interrupt
+	uint32_t start = micros();
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+	if (!_posted)
+	{
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+	_idle += micros() - start;
+}
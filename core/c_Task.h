@@ -0,0 +1,58 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <Arduino.h>
+
+// Cooperative task scheduler
+//
+// Tasks are plain functions run from the main loop when their deadline
+// (in milliseconds, see millis()) is reached or when they have been posted
+// (e.g. from an interrupt). When nothing is due, the MCU sleeps in idle mode
+// until the next interrupt: the Timer0 overflow (every 1.024 ms), USB or
+// any other enabled interrupt. To use it, end the program with:
+//
+//     void loop()
+//     {
+//         Task_loop();
+//     }
+
+#define TASK_MAX 8
+
+typedef void (*TaskFunc)(void);
+
+typedef struct
+{
+	uint16_t runs;    // number of runs
+	uint16_t missed;  // periods skipped because the task ran too late
+	uint16_t maxTime; // longest run, in microseconds
+	uint32_t time;    // total run time, in microseconds
+} TaskStats;
+
+int8_t           Task_every (TaskFunc func, uint16_t period, uint16_t delay);
+int8_t           Task_after (TaskFunc func, uint16_t delay);
+int8_t           Task_event (TaskFunc func);
+void             Task_post  (int8_t id);
+void             Task_cancel(int8_t id);
+void             Task_loop  (void);
+const TaskStats* Task_stats (int8_t id);
+uint32_t         Task_idle  (void);
+
+#endif
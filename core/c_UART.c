@@ -0,0 +1,260 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#include <avr/interrupt.h>
+
+#include "c_UART.h"
+
+#if defined(UDR0)
+#define UDR      UDR0
+#define UCSRA    UCSR0A
+#define UCSRB    UCSR0B
+#define UCSRC    UCSR0C
+#define UBRR     UBRR0
+#define RXC      RXC0
+#define TXC      TXC0
+#define UDRE     UDRE0
+#define DOR      DOR0
+#define U2X      U2X0
+#define MPCM     MPCM0
+#define RXCIE    RXCIE0
+#define UDRIE    UDRIE0
+#define RXEN     RXEN0
+#define TXEN     TXEN0
+#define UCSZ0    UCSZ00
+#define UCSZ1    UCSZ01
+#if defined(USART_RX_vect)
+#define RX_vect   USART_RX_vect
+#define UDRE_vect USART_UDRE_vect
+#else
+#define RX_vect   USART0_RX_vect
+#define UDRE_vect USART0_UDRE_vect
+#endif
+#elif defined(UDR1)
+#define UDR      UDR1
+#define UCSRA    UCSR1A
+#define UCSRB    UCSR1B
+#define UCSRC    UCSR1C
+#define UBRR     UBRR1
+#define RXC      RXC1
+#define TXC      TXC1
+#define UDRE     UDRE1
+#define DOR      DOR1
+#define U2X      U2X1
+#define MPCM     MPCM1
+#define RXCIE    RXCIE1
+#define UDRIE    UDRIE1
+#define RXEN     RXEN1
+#define TXEN     TXEN1
+#define UCSZ0    UCSZ10
+#define UCSZ1    UCSZ11
+#define RX_vect   USART1_RX_vect
+#define UDRE_vect USART1_UDRE_vect
+#else
+#error "no USART on this MCU"
+#endif
+
+#define RX_MASK (UART_RX_SIZE - 1)
+#define TX_MASK (UART_TX_SIZE - 1)
+
+static uint8_t           _rx[UART_RX_SIZE];
+static volatile uint8_t  _rxHead; // moved by the interrupt
+static volatile uint8_t  _rxTail;
+static uint8_t           _tx[UART_TX_SIZE];
+static volatile uint8_t  _txHead;
+static volatile uint8_t  _txTail; // moved by the interrupt
+static volatile uint16_t _overruns;
+static uint8_t           _written; // since the last UART_flush(): TXC means something
+
+// UBRR for baud, with or without double speed; saturates at both ends
+static uint16_t divisor(uint32_t baud, uint8_t u2x)
+{
+	uint32_t top = F_CPU / (u2x ? 4 : 8);
+	if (baud == 0)
+		return 4095;
+	if (baud >= top / 2)
+		return 0;
+	uint32_t d = (top / baud - 1) / 2;
+	return d > 4095 ? 4095 : (uint16_t) d;
+}
+
+static uint32_t error(uint32_t baud, uint8_t u2x, uint16_t ubrr)
+{
+	uint32_t actual = F_CPU / (u2x ? 8 : 16) / (ubrr + 1UL);
+	return actual > baud ? actual - baud : baud - actual;
+}
+
+// 8N1; up to F_CPU / 8 (2 Mbaud at 16 MHz), using double speed whenever
+// it gives a closer rate; faster rates get F_CPU / 8, 0 the slowest rate
+void UART_begin(uint32_t baud)
+{
+	uint16_t fast = divisor(baud, 1);
+	uint16_t slow = divisor(baud, 0);
+	uint8_t u2x = error(baud, 1, fast) <= error(baud, 0, slow);
+
+	UART_end();
+	_rxHead = _rxTail = 0;
+	_txHead = _txTail = 0;
+	_overruns = 0;
+
+	UCSRA = u2x ? 1 << U2X : 0;
+	UBRR  = u2x ? fast : slow;
+	UCSRC = (1 << UCSZ1) | (1 << UCSZ0);
+	UCSRB = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE);
+}
+
+void UART_end(void)
+{
+	if (UCSRB & (1 << TXEN))
+		UART_flush();
+	UCSRB = 0;
+}
+
+int UART_available(void)
+{
+	return (uint8_t) (_rxHead - _rxTail) & RX_MASK;
+}
+
+int UART_peek(void)
+{
+	if (_rxHead == _rxTail)
+		return -1;
+	return _rx[_rxTail];
+}
+
+int UART_read(void)
+{
+	uint8_t t = _rxTail;
+	if (_rxHead == t)
+		return -1;
+	uint8_t c = _rx[t];
+	_rxTail = (t + 1) & RX_MASK;
+	return c;
+}
+
+// reads what has been received, up to size bytes; does not wait
+size_t UART_readBytes(uint8_t* buffer, size_t size)
+{
+	uint8_t t = _rxTail;
+	uint8_t h = _rxHead;
+	size_t n = 0;
+	while (n < size && t != h)
+	{
+		buffer[n++] = _rx[t];
+		t = (t + 1) & RX_MASK;
+	}
+	_rxTail = t;
+	return n;
+}
+
+// bytes lost because the ring or the USART itself was full
+uint16_t UART_overruns(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t r = _overruns;
+	SREG = sreg;
+	return r;
+}
+
+// move the next byte from the ring to the USART
+static inline void txNext(void)
+{
+	uint8_t t = _txTail;
+	UDR = _tx[t];
+	_txTail = t = (t + 1) & TX_MASK;
+	if (t == _txHead)
+		UCSRB &= (uint8_t) ~(1 << UDRIE);
+}
+
+// wait until everything has been sent; TXC is only set once a byte went
+// out, so a port that sent nothing returns at once
+void UART_flush(void)
+{
+	if (!_written)
+		return;
+	while ((UCSRB & (1 << UDRIE)) || !(UCSRA & (1 << TXC)))
+	{
+		// with interrupts disabled, do the interrupt's work
+		if (!(SREG & 0x80) && (UCSRB & (1 << UDRIE)) && (UCSRA & (1 << UDRE)))
+			txNext();
+	}
+	_written = 0;
+}
+
+size_t UART_write(uint8_t c)
+{
+	_written = 1;
+
+	// clear TXC for UART_flush(), keeping the configuration bits
+	UCSRA = (uint8_t) ((UCSRA & ((1 << U2X) | (1 << MPCM))) | (1 << TXC));
+
+	// nothing queued: skip the ring
+	if (_txHead == _txTail && (UCSRA & (1 << UDRE)))
+	{
+		UDR = c;
+		return 1;
+	}
+
+	uint8_t h = _txHead;
+	uint8_t next = (h + 1) & TX_MASK;
+	while (next == _txTail)
+	{
+		if (!(SREG & 0x80) && (UCSRA & (1 << UDRE)))
+			txNext();
+	}
+	_tx[h] = c;
+
+	uint8_t sreg = SREG;
+	cli();
+	_txHead = next;
+	UCSRB |= 1 << UDRIE;
+	SREG = sreg;
+	return 1;
+}
+
+// queues the whole buffer, waiting for room in the ring when needed
+size_t UART_writeBytes(const uint8_t* buffer, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		UART_write(buffer[i]);
+	return size;
+}
+
+ISR(RX_vect)
+{
+	uint8_t status = UCSRA;
+	uint8_t c = UDR;
+	uint8_t h = _rxHead;
+	uint8_t next = (h + 1) & RX_MASK;
+
+	if (status & (1 << DOR))
+		_overruns++;
+	if (next == _rxTail)
+	{
+		_overruns++;
+		return;
+	}
+	_rx[h] = c;
+	_rxHead = next;
+}
+
+ISR(UDRE_vect)
+{
+	txNext();
+}
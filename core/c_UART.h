@@ -0,0 +1,49 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+#ifndef UART_H
+#define UART_H
+
+#include <Arduino.h>
+
+// Interrupt-driven serial port (USART0, or USART1 on the Leonardo)
+//
+// Same calls as the CDC serial port (Serial_*), plus bulk reads and writes
+// that move a whole buffer at once. Reception and transmission go through
+// rings filled and emptied by the USART interrupts.
+
+// ring sizes, powers of 2 up to 256
+#ifndef UART_RX_SIZE
+#define UART_RX_SIZE 64
+#endif
+#ifndef UART_TX_SIZE
+#define UART_TX_SIZE 64
+#endif
+
+void     UART_begin     (uint32_t baud);
+void     UART_end       (void);
+int      UART_available (void);
+int      UART_peek      (void);
+int      UART_read      (void);
+size_t   UART_readBytes (uint8_t* buffer, size_t size);
+void     UART_flush     (void);
+size_t   UART_write     (uint8_t c);
+size_t   UART_writeBytes(const uint8_t* buffer, size_t size);
+uint16_t UART_overruns  (void);
+
+#endif
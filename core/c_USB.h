@@ -31,6 +31,60 @@ typedef unsigned long  u32;
 #include <USBCore.h>
 #include <USBDesc.h>
 
+// frees the HID endpoint, for a second CDC port for instance
+//#define HID_DISABLED
+
+#ifdef HID_DISABLED
+#undef  HID_ENABLED
+#undef  HID_INTERFACE_COUNT
+#undef  HID_ENPOINT_COUNT
+#define HID_INTERFACE_COUNT    0
+#define HID_ENPOINT_COUNT      0
+#endif
+
+// traffic and error counters, see USBStats
+//#define USB_STATS_ENABLED
+
+// optional classes, placed after those of USBDesc.h
+//#define AUDIO_ENABLED
+//#define MIDI_ENABLED
+
+#ifdef AUDIO_ENABLED
+#define AUDIO_INTERFACE_COUNT  2
+#define AUDIO_ENPOINT_COUNT    1
+#else
+#define AUDIO_INTERFACE_COUNT  0
+#define AUDIO_ENPOINT_COUNT    0
+#endif
+
+#define AUDIO_AC_INTERFACE     (HID_INTERFACE + HID_INTERFACE_COUNT)
+#define AUDIO_STREAM_INTERFACE (AUDIO_AC_INTERFACE + 1)
+#define AUDIO_FIRST_ENDPOINT   (HID_FIRST_ENDPOINT + HID_ENPOINT_COUNT)
+#define AUDIO_ENDPOINT_ISO     (AUDIO_FIRST_ENDPOINT)
+
+#ifdef MIDI_ENABLED
+#define MIDI_INTERFACE_COUNT   2
+#define MIDI_ENPOINT_COUNT     2
+#else
+#define MIDI_INTERFACE_COUNT   0
+#define MIDI_ENPOINT_COUNT     0
+#endif
+
+#define MIDI_AC_INTERFACE      (AUDIO_AC_INTERFACE + AUDIO_INTERFACE_COUNT)
+#define MIDI_STREAM_INTERFACE  (MIDI_AC_INTERFACE + 1)
+#define MIDI_FIRST_ENDPOINT    (AUDIO_FIRST_ENDPOINT + AUDIO_ENPOINT_COUNT)
+#define MIDI_ENDPOINT_OUT      (MIDI_FIRST_ENDPOINT)
+#define MIDI_ENDPOINT_IN       (MIDI_FIRST_ENDPOINT + 1)
+
+#ifdef AUDIO_ENABLED
+#define AUDIO_TX AUDIO_ENDPOINT_ISO
+#endif
+
+#ifdef MIDI_ENABLED
+#define MIDI_RX MIDI_ENDPOINT_OUT
+#define MIDI_TX MIDI_ENDPOINT_IN
+#endif
+
 // from USBAPI.h
 #define TRANSFER_PGM     0x80
 #define TRANSFER_RELEASE 0x40
@@ -57,20 +111,169 @@ int USB_Recv           (u8 ep, void* d, int len);
 u8  USB_SendSpace      (u8 ep);
 int USB_Send           (u8 ep, const void* d, int len);
 int USB_RecvControl    (void* d, int len);
-u8  USBConnected       ();
+u8  USBConnected       (); // configured and not suspended
+u16 USB_FrameNumber    (void); // 11 bits, of the last start of frame
+
+// device state, as seen from the bus
+#define USB_STATE_DETACHED   0 // no VBUS
+#define USB_STATE_ATTACHED   1 // powered, or reset by the host
+#define USB_STATE_CONFIGURED 2
+#define USB_STATE_SUSPENDED  3 // no activity for 3 ms, the USB clock is frozen
+
+// called from the interrupt on each change of state
+typedef void (*USBStateHandler)(u8 state);
+
+u8   USB_state       (void);
+void USB_stateHandler(USBStateHandler handler);
+
+// sleeps in power-down mode if the bus is suspended; the USB resume, or
+// any interrupt working without clock (INTn, pin change, watchdog), wakes
+// it up; millis() does not count while asleep; interrupts must be enabled
+void USB_sleep       (void);
+
+// signals a resume to the host, if the bus is suspended and the host has
+// enabled remote wakeup (only offered with HID)
+bool USB_wakeup      (void);
 
 void USB_attach();
 
+#define USB_ENDPOINTS 7 // EP0 to EP6
+
+// endpoint types (UECFG0X)
+#define EP_TYPE_CONTROL         0x00
+#define EP_TYPE_BULK_IN         0x81
+#define EP_TYPE_BULK_OUT        0x80
+#define EP_TYPE_INTERRUPT_IN    0xC1
+#define EP_TYPE_INTERRUPT_OUT   0xC0
+#define EP_TYPE_ISOCHRONOUS_IN  0x41
+#define EP_TYPE_ISOCHRONOUS_OUT 0x40
+
+typedef struct
+{
+	u8  type;
+	u16 size; // largest packet
+} USBEndpoint;
+
+// class driver
+//
+// USB_plug() adds a class after those already there, numbers its
+// interfaces and endpoints after theirs, and shares the DPRAM between the
+// endpoints of all the classes. The class then sends its descriptors with
+// its numbers, and gets the setup requests for its interfaces and
+// endpoints (standard GET_INTERFACE/SET_INTERFACE included, for alternate
+// settings). The classes of USBDesc.h and c_USB.h are plugged first.
+// The callbacks get the class they were registered with, so that a driver
+// can be plugged several times, embedding USBClass as the first member of
+// its own structure. A class without interfaces nor endpoints only gets
+// the start of frame calls.
+typedef struct USBClass USBClass;
+struct USBClass
+{
+	u8                 interfaceCount;
+	u8                 endpointCount;
+	const USBEndpoint* endpoints;                       // in program memory
+	int              (*getInterface) (USBClass* c, u8* interfaceNum); // configuration descriptors, may be NULL
+	int              (*getDescriptor)(USBClass* c, int type);         // may be NULL
+	bool             (*setup)        (USBClass* c, Setup* setup);     // may be NULL
+	void             (*sof)          (USBClass* c);                   // may be NULL
+
+	// set by USB_plug()
+	u8                 firstInterface;
+	u8                 firstEndpoint;
+	USBClass*          next;
+};
+
+// returns false if the endpoints do not fit; when called after the host
+// has enumerated the device, the device reconnects
+bool USB_plug(USBClass* c);
+
+#ifdef USB_STATS_ENABLED
+// counters of the traffic of each endpoint, maintained by USB_Send(),
+// USB_Recv() and USB_Flush() (bytes and packets) and by the classes
+// (overflows); they wrap around
+typedef struct
+{
+	u32 bytes;
+	u16 packets;   // banks released to the host, or emptied
+	u16 timeouts;  // USB_Send() giving up, the host not polling
+	u16 flushes;   // short packets sent by USB_Flush()
+	u16 overflows; // bytes dropped on reception, the ring being full
+} USBEndpointStats;
+
+typedef struct
+{
+	USBEndpointStats endpoints[USB_ENDPOINTS];
+	u16              stalls; // control requests refused
+	u16              resets; // bus resets
+} USBStats;
+
+// vendor request to the device, from the host: returns USBStats (88 bytes,
+// little-endian, without padding); wValue 1 then clears the counters
+#define USB_STATS_REQUEST 0x5A
+
+extern USBStats _usbStats;
+
+#define USB_COUNT(ep, field, n) (_usbStats.endpoints[(ep) & 7].field += (n))
+
+// copy of the counters, taken with interrupts disabled
+void USB_stats(USBStats* stats, bool clear);
+#else
+#define USB_COUNT(ep, field, n) ((void) 0)
+#endif
+
 #ifdef HID_ENABLED
-int  HID_GetInterface (u8* interfaceNum);
-int  HID_GetDescriptor(int i);
+int  HID_GetInterface (USBClass* c, u8* interfaceNum);
+int  HID_GetDescriptor(USBClass* c, int i);
 void HID_SendReport   (u8 id, const void* data, int len);
-bool HID_Setup        (Setup* setup);
+bool HID_Setup        (USBClass* c, Setup* setup);
 #endif
 
 #ifdef CDC_ENABLED
-int    CDC_GetInterface(u8* interfaceNum);
-bool   CDC_Setup       (Setup* setup);
+#if (RAMEND < 1000)
+#define SERIAL_BUFFER_SIZE 16
+#else
+#define SERIAL_BUFFER_SIZE 64
+#endif
+
+typedef struct
+{
+	u32	dwDTERate;
+	u8	bCharFormat;
+	u8 	bParityType;
+	u8 	bDataBits;
+	u8	lineState;
+} LineInfo;
+
+// CDC-ACM port: two interfaces (and an IAD) with an interrupt endpoint,
+// then bulk OUT and IN endpoints. Serial_port is the one of USBDesc.h
+// (CDC_ACM_INTERFACE, CDC_RX, CDC_TX) and the Serial_* functions use it;
+// more ports are added with CDC_begin(), usually with HID_DISABLED since
+// the ATmega32u4 only has 6 endpoints.
+typedef struct
+{
+	USBClass          usb;
+	unsigned char     buffer[SERIAL_BUFFER_SIZE];
+	volatile int      head;
+	volatile int      tail;
+	volatile LineInfo lineInfo;
+} CDCPort;
+
+extern CDCPort Serial_port;
+
+#define CDC_PORT_RX(port) ((u8) ((port)->usb.firstEndpoint + 1))
+#define CDC_PORT_TX(port) ((u8) ((port)->usb.firstEndpoint + 2))
+
+int    CDC_GetInterface(USBClass* c, u8* interfaceNum);
+bool   CDC_Setup       (USBClass* c, Setup* setup);
+
+bool   CDC_begin       (CDCPort* port);
+void   CDC_accept      (CDCPort* port);
+int    CDC_available   (CDCPort* port);
+int    CDC_peek        (CDCPort* port);
+int    CDC_read        (CDCPort* port);
+void   CDC_flush       (CDCPort* port);
+size_t CDC_write       (CDCPort* port, const void* data, size_t size);
+bool   CDC_connected   (CDCPort* port);
 
 void   Serial_accept   (void);
 int    Serial_available(void);
@@ -78,6 +281,45 @@ int    Serial_peek     (void);
 int    Serial_read     (void);
 void   Serial_flush    (void);
 size_t Serial_write    (uint8_t c);
+size_t Serial_writeBytes(const uint8_t* data, size_t size);
+bool   Serial_connected(void);
+#endif
+
+#ifdef AUDIO_ENABLED
+// 16-bit mono microphone at AUDIO_RATE samples per second
+#define AUDIO_RATE 8000
+
+int  Audio_GetInterface(USBClass* c, u8* interfaceNum);
+bool Audio_Setup       (USBClass* c, Setup* setup);
+void Audio_SOF         (USBClass* c);
+
+bool Audio_streaming   (void);
+int  Audio_space       (void);
+int  Audio_write       (const int16_t* samples, int count);
+#endif
+
+#ifdef MIDI_ENABLED
+// USB-MIDI event packet: cable number (bits 7-4) and code index (bits 3-0),
+// then the MIDI message, padded with zeros
+typedef struct
+{
+	u8 header;
+	u8 data[3];
+} MIDIEvent;
+
+int  MIDI_GetInterface(USBClass* c, u8* interfaceNum);
+void MIDI_SOF         (USBClass* c);
+
+// both may be called from interrupts; MIDI_send() returns false if the
+// queue is full, MIDI_receive() if there is no event
+bool MIDI_send        (const MIDIEvent* event);
+bool MIDI_receive     (MIDIEvent* event);
+int  MIDI_available   (void);
+
+// channel messages on cable 0; channel is 0-15
+bool MIDI_noteOn       (u8 channel, u8 note, u8 velocity);
+bool MIDI_noteOff      (u8 channel, u8 note, u8 velocity);
+bool MIDI_controlChange(u8 channel, u8 control, u8 value);
 #endif
 
 #endif
@@ -16,20 +16,13 @@
 
 #include <avr/pgmspace.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <util/delay.h>
 
 #include "c_USB.h"
 
 #if defined(USBCON)
 
-#define EP_TYPE_CONTROL         0x00
-#define EP_TYPE_BULK_IN         0x81
-#define EP_TYPE_BULK_OUT        0x80
-#define EP_TYPE_INTERRUPT_IN    0xC1
-#define EP_TYPE_INTERRUPT_OUT   0xC0
-#define EP_TYPE_ISOCHRONOUS_IN  0x41
-#define EP_TYPE_ISOCHRONOUS_OUT 0x40
-
 //==================================================================
 //                     DEVICE DESCRIPTION
 //==================================================================
@@ -85,6 +78,15 @@ volatile u8 RxLEDPulse; // milliseconds remaining for RX LED pulse
 
 volatile u8 _curConf = 0;
 
+static volatile u8      _state;        // USB_STATE_*
+static u8               _resumeState;  // before the suspension
+static volatile bool    _remoteWakeup; // enabled by the host
+static USBStateHandler  _stateHandler;
+
+#ifndef DEVICE_REMOTE_WAKEUP
+#define DEVICE_REMOTE_WAKEUP 1
+#endif
+
 static inline void WaitIN(void)
 {
 	while (!(UEINTX & (1<<TXINI)));
@@ -185,9 +187,10 @@ static inline void ReleaseTX()
 	UEINTX = 0x3A; // FIFOCON=0 NAKINI=0 RWAL=1 NAKOUTI=1 RXSTPI=1 RXOUTI=0 STALLEDI=1 TXINI=0
 }
 
-static inline u8 FrameNumber()
+static inline u16 FrameNumber()
 {
-	return UDFNUML;
+	u8 l = UDFNUML;
+	return (u16) ((UDFNUMH & 0x07) << 8 | l);
 }
 
 
@@ -196,7 +199,12 @@ static inline u8 FrameNumber()
 //==================================================================
 
 #define EP_SINGLE_64 0x32 // EP0
-#define EP_DOUBLE_64 0x36 // Other endpoints
+
+// UECFG1X: bank size (8 << EPSIZE) in bits 6:4, double bank, allocation
+#define EP_DOUBLE    0x04
+#define EP_ALLOC     0x02
+
+#define USB_DPRAM     832 // bytes shared by the banks of all endpoints
 
 static inline void InitEP(u8 index, u8 type, u8 size)
 {
@@ -206,28 +214,194 @@ static inline void InitEP(u8 index, u8 type, u8 size)
 	UECFG1X = size;
 }
 
-static const u8 _initEndpoints[] PROGMEM =
-{
-	0,
+//==================================================================
+//                         CLASS REGISTRY
+//==================================================================
 
-#ifdef CDC_ENABLED
-	EP_TYPE_INTERRUPT_IN, // CDC_ENDPOINT_ACM
-	EP_TYPE_BULK_OUT,     // CDC_ENDPOINT_OUT
-	EP_TYPE_BULK_IN,      // CDC_ENDPOINT_IN
+#if MIDI_FIRST_ENDPOINT + MIDI_ENPOINT_COUNT > USB_ENDPOINTS
+#error "the ATmega32u4 only has endpoints 1 to 6"
 #endif
 
 #ifdef HID_ENABLED
-	EP_TYPE_INTERRUPT_IN,  // HID_ENDPOINT_INT
+static const USBEndpoint _hidEndpoints[] PROGMEM =
+{
+	{ EP_TYPE_INTERRUPT_IN, 0x40 }, // HID_ENDPOINT_INT
+};
+static USBClass _hid = { 1, 1, _hidEndpoints, HID_GetInterface, HID_GetDescriptor, HID_Setup, 0, 0, 0, 0 };
+#endif
+
+#ifdef AUDIO_ENABLED
+static const USBEndpoint _audioEndpoints[] PROGMEM =
+{
+	{ EP_TYPE_ISOCHRONOUS_IN, 2 * (AUDIO_RATE / 1000 + 1) }, // AUDIO_ENDPOINT_ISO
+};
+static USBClass _audio = { 2, 1, _audioEndpoints, Audio_GetInterface, 0, Audio_Setup, Audio_SOF, 0, 0, 0 };
 #endif
+
+#ifdef MIDI_ENABLED
+static const USBEndpoint _midiEndpoints[] PROGMEM =
+{
+	{ EP_TYPE_BULK_OUT, 0x40 }, // MIDI_ENDPOINT_OUT
+	{ EP_TYPE_BULK_IN,  0x40 }, // MIDI_ENDPOINT_IN
 };
+static USBClass _midi = { 2, 2, _midiEndpoints, MIDI_GetInterface, 0, 0, MIDI_SOF, 0, 0, 0 };
+#endif
+
+static USBClass* _classes;
+static u8        _interfaces;       // interfaces numbered so far
+static u8        _endpoints = 1;    // endpoints numbered so far, with EP0
+static u8        _epType  [USB_ENDPOINTS];
+static u8        _epConfig[USB_ENDPOINTS];
+
+// gives each endpoint the smallest bank that holds its packets, then
+// doubles the banks while the DPRAM allows it, those of isochronous and
+// bulk endpoints first; returns false if the endpoints do not fit
+static bool Allocate(void)
+{
+	u16 bytes[USB_ENDPOINTS];
+	int left = USB_DPRAM - 64; // EP0
+	u8  n = 1;
+	for (USBClass* c = _classes; c; c = c->next)
+	{
+		for (u8 i = 0; i < c->endpointCount; i++, n++)
+		{
+			if (n >= USB_ENDPOINTS)
+				return false;
+			u16 size = pgm_read_word(&c->endpoints[i].size);
+			u8  code = 0;
+			bytes[n] = 8;
+			while (bytes[n] < size)
+			{
+				bytes[n] <<= 1;
+				code++;
+			}
+			if (bytes[n] > (n == 1 ? 256 : 64)) // only EP1 has larger banks
+				return false;
+			_epType[n]   = pgm_read_byte(&c->endpoints[i].type);
+			_epConfig[n] = (u8) ((code << 4) | EP_ALLOC);
+			left -= bytes[n];
+		}
+	}
+	if (left < 0)
+		return false;
+
+	for (u8 interrupt = 0; interrupt < 2; interrupt++)
+	{
+		for (u8 i = 1; i < n; i++)
+		{
+			if (((_epType[i] & 0xC0) == 0xC0) != interrupt || bytes[i] > left)
+				continue;
+			_epConfig[i] |= EP_DOUBLE;
+			left -= bytes[i];
+		}
+	}
+	_endpoints = n;
+	return true;
+}
+
+// numbers the interfaces and endpoints of a class after those of the
+// others; interrupts must be disabled
+static bool Plug(USBClass* c)
+{
+	USBClass** last = &_classes;
+	while (*last)
+		last = &(*last)->next;
+
+	c->next = 0;
+	c->firstInterface = _interfaces;
+	c->firstEndpoint  = _endpoints;
+	*last = c;
+	if (!Allocate())
+	{
+		*last = 0;
+		Allocate();
+		return false;
+	}
+	_interfaces += c->interfaceCount;
+	return true;
+}
+
+// the classes of USBDesc.h and c_USB.h come first, in this order, so that
+// they get the numbers of their constants
+static void PlugBuiltins(void)
+{
+	static bool done;
+	if (done)
+		return;
+	done = true;
+#ifdef CDC_ENABLED
+	Plug(&Serial_port.usb);
+#endif
+#ifdef HID_ENABLED
+	Plug(&_hid);
+#endif
+#ifdef AUDIO_ENABLED
+	Plug(&_audio);
+#endif
+#ifdef MIDI_ENABLED
+	Plug(&_midi);
+#endif
+}
+
+bool USB_plug(USBClass* c)
+{
+	u8 sreg = SREG;
+	cli();
+	PlugBuiltins();
+	bool ok = Plug(c);
+	SREG = sreg;
+	if (!ok)
+		return false;
+
+	// the host already enumerated the device without the class
+	if ((c->interfaceCount || c->endpointCount) && (UDADDR & (1<<ADDEN)))
+	{
+		UDCON |= 1<<DETACH;
+		delay(10);
+		UDCON &= (u8) ~(1<<DETACH);
+	}
+	return true;
+}
+
+// class owning an interface or an endpoint
+static USBClass* InterfaceClass(u8 interface)
+{
+	for (USBClass* c = _classes; c; c = c->next)
+		if (interface >= c->firstInterface && interface < c->firstInterface + c->interfaceCount)
+			return c;
+	return 0;
+}
+
+static USBClass* EndpointClass(u8 ep)
+{
+	for (USBClass* c = _classes; c; c = c->next)
+		if (ep >= c->firstEndpoint && ep < c->firstEndpoint + c->endpointCount)
+			return c;
+	return 0;
+}
+
+// class a request is for, according to its recipient
+static USBClass* RequestClass(Setup* setup)
+{
+	switch (setup->bmRequestType & REQUEST_RECIPIENT)
+	{
+	case REQUEST_INTERFACE:
+		return InterfaceClass((u8) setup->wIndex);
+	case REQUEST_ENDPOINT:
+		return EndpointClass(setup->wIndex & 0x0F);
+	default:
+		return 0;
+	}
+}
+
 static inline void InitEndpoints()
 {
-	for (u8 i = 1; i < sizeof(_initEndpoints); i++)
+	for (u8 i = 1; i < _endpoints; i++)
 	{
 		UENUM = i;
 		UECONX = 1;
-		UECFG0X = pgm_read_byte(_initEndpoints+i);
-		UECFG1X = EP_DOUBLE_64;
+		UECFG0X = _epType[i];
+		UECFG1X = _epConfig[i];
 	}
 	UERST = 0x7E;	// And reset them
 	UERST = 0;
@@ -276,26 +450,23 @@ int SendInterfaces()
 	int total = 0;
 	u8 interfaces = 0;
 
-#ifdef CDC_ENABLED
-	total = CDC_GetInterface(&interfaces);
-#endif
-
-#ifdef HID_ENABLED
-	total += HID_GetInterface(&interfaces);
-#endif
+	for (USBClass* c = _classes; c; c = c->next)
+		if (c->getInterface)
+			total += c->getInterface(c, &interfaces);
 
 	return interfaces;
 }
 
 // Construct a dynamic configuration descriptor
-// This really needs dynamic endpoint allocation etc
-// TODO
 static inline bool SendConfiguration(int maxlen)
 {
 	// Count and measure interfaces
 	InitControl(0);
 	int interfaces = SendInterfaces();
 	ConfigDescriptor config = D_CONFIG(_cmark + sizeof(ConfigDescriptor),interfaces);
+#ifdef HID_ENABLED
+	config.attributes |= USB_CONFIG_REMOTE_WAKEUP; // keyboards and mice wake the host up
+#endif
 
 	// Now send them
 	InitControl(maxlen);
@@ -313,10 +484,12 @@ static bool SendDescriptor(Setup* setup)
 		return SendConfiguration(setup->wLength);
 
 	InitControl(setup->wLength);
-#ifdef HID_ENABLED
-	if (HID_REPORT_DESCRIPTOR_TYPE == t)
-		return HID_GetDescriptor(t);
-#endif
+	if ((setup->bmRequestType & REQUEST_RECIPIENT) == REQUEST_INTERFACE)
+	{
+		// class descriptors, such as HID reports
+		USBClass* c = InterfaceClass((u8) setup->wIndex);
+		return c && c->getDescriptor && c->getDescriptor(c, t) > 0;
+	}
 
 	u8 desc_length = 0;
 	const u8* desc_addr = 0;
@@ -347,6 +520,15 @@ static bool SendDescriptor(Setup* setup)
 	return true;
 }
 
+static void SetState(u8 state)
+{
+	if (state == _state)
+		return;
+	_state = state;
+	if (_stateHandler)
+		_stateHandler(state);
+}
+
 // communication interrupt
 ISR(USB_COM_vect)
 {
@@ -377,9 +559,15 @@ ISR(USB_COM_vect)
 		switch (setup.bRequest)
 		{
 		case GET_STATUS:
-			Send8(0);
+			// bus powered; remote wakeup enabled or not
+			Send8((requestType & REQUEST_RECIPIENT) == REQUEST_DEVICE && _remoteWakeup ? 2 : 0);
 			Send8(0);
 			break;
+		case SET_FEATURE:
+		case CLEAR_FEATURE:
+			if ((requestType & REQUEST_RECIPIENT) == REQUEST_DEVICE && setup.wValueL == DEVICE_REMOTE_WAKEUP)
+				_remoteWakeup = setup.bRequest == SET_FEATURE;
+			break;
 		case SET_ADDRESS:
 			WaitIN();
 			UDADDR = setup.wValueL | (1<<ADDEN);
@@ -393,12 +581,27 @@ ISR(USB_COM_vect)
 		case GET_CONFIGURATION:
 			Send8(1);
 			break;
+		case GET_INTERFACE:
+		case SET_INTERFACE:
+			// alternate settings, for the classes that have some
+			InitControl(setup.wLength);
+			{
+				USBClass* c = InterfaceClass((u8) setup.wIndex);
+				if (c && c->setup && c->setup(c, &setup))
+					break;
+			}
+			if (setup.bRequest == GET_INTERFACE)
+				Send8(0);
+			else
+				ok = setup.wValueL == 0;
+			break;
 		case SET_CONFIGURATION:
 			switch (requestType & REQUEST_RECIPIENT)
 			{
 			case REQUEST_DEVICE:
 				InitEndpoints();
 				_curConf = setup.wValueL;
+				SetState(_curConf ? USB_STATE_CONFIGURED : USB_STATE_ATTACHED);
 				break;
 			default:
 				ok = false; // should not occur
@@ -408,22 +611,25 @@ ISR(USB_COM_vect)
 		break;
 	case REQUEST_CLASS:
 		InitControl(setup.wLength); // Max length of transfer
-		switch (setup.wIndex)
 		{
-#ifdef CDC_ENABLED
-		case CDC_ACM_INTERFACE:
-			ok = CDC_Setup(&setup);
-			break;
-#endif
-#ifdef HID_ENABLED
-		case HID_INTERFACE:
-			ok = HID_Setup(&setup);
-			break;
-#endif
-		default:
-			break;
+			USBClass* c = RequestClass(&setup);
+			if (c && c->setup)
+				ok = c->setup(c, &setup);
+		}
+		break;
+#ifdef USB_STATS_ENABLED
+	case REQUEST_VENDOR:
+		ok = requestType == (REQUEST_DEVICETOHOST | REQUEST_VENDOR | REQUEST_DEVICE) &&
+		     setup.bRequest == USB_STATS_REQUEST;
+		if (ok)
+		{
+			InitControl(setup.wLength);
+			USB_SendControl(0, &_usbStats, sizeof(_usbStats));
+			if (setup.wValueL == 1)
+				memset(&_usbStats, 0, sizeof(_usbStats));
 		}
 		break;
+#endif
 	default:
 		ok = false; // should not occur
 	}
@@ -431,7 +637,12 @@ ISR(USB_COM_vect)
 	if (ok)
 		ClearIN();
 	else
+	{
 		Stall();
+#ifdef USB_STATS_ENABLED
+		_usbStats.stalls++;
+#endif
+	}
 }
 
 
@@ -453,32 +664,106 @@ u8 USB_Available(u8 ep)
 
 void USB_Flush(u8 ep)
 {
-	SetEP(ep);
+	LOCKEP;
 	if (FifoByteCount())
+	{
 		ReleaseTX();
+		USB_COUNT(ep, flushes, 1);
+		USB_COUNT(ep, packets, 1);
+	}
+	UNLOCKEP;
+}
+
+#ifdef USB_STATS_ENABLED
+USBStats _usbStats;
+
+void USB_stats(USBStats* stats, bool clear)
+{
+	u8 sreg = SREG;
+	cli();
+	*stats = _usbStats;
+	if (clear)
+		memset(&_usbStats, 0, sizeof(_usbStats));
+	SREG = sreg;
+}
+#endif
+
+// the PLL and the USB clock are stopped during suspension
+static void ClockOn(void)
+{
+	PLLCSR |= 1<<PLLE;
+	while (!(PLLCSR & (1<<PLOCK)));
+	USBCON &= (u8) ~(1<<FRZCLK);
+}
+
+static void ClockOff(void)
+{
+	USBCON |= 1<<FRZCLK;
+	PLLCSR &= (u8) ~(1<<PLLE);
+}
+
+static void Suspend(void)
+{
+	UDINT  &= (u8) ~(1<<WAKEUPI); // set by any bus activity so far
+	UDIEN   = (u8) ((UDIEN & ~(1<<SUSPE)) | (1<<WAKEUPE));
+	ClockOff();
+	if (_state != USB_STATE_SUSPENDED)
+		_resumeState = _state;
+	SetState(USB_STATE_SUSPENDED);
+}
+
+static void Resume(void)
+{
+	ClockOn();
+	UDINT &= (u8) ~(1<<WAKEUPI); // only possible with the clock running
+	UDIEN  = (u8) ((UDIEN & ~(1<<WAKEUPE)) | (1<<SUSPE));
+	if (_state == USB_STATE_SUSPENDED)
+		SetState(_resumeState);
 }
 
 // General interrupt
 ISR(USB_GEN_vect)
 {
 	u8 udint = UDINT;
+	u8 udien = UDIEN;
 	UDINT = 0;
 
+	if (USBINT & (1<<VBUSTI)) // VBUS plugged or unplugged
+	{
+		USBINT = 0;
+		if (USBSTA & (1<<VBUS))
+			SetState(USB_STATE_ATTACHED);
+		else
+		{
+			_curConf = 0;
+			SetState(USB_STATE_DETACHED);
+		}
+	}
+
+	// the flags are set whatever the enabled interrupts
+	if ((udint & (1<<WAKEUPI)) && (udien & (1<<WAKEUPE)))
+		Resume();
+	if ((udint & (1<<SUSPI)) && (udien & (1<<SUSPE)))
+		Suspend();
+
 	if (udint & (1<<EORSTI)) // End of Reset
 	{
 		InitEP(0, EP_TYPE_CONTROL, EP_SINGLE_64); // init EP0
 		_curConf = 0;                             // not configured yet
+		_remoteWakeup = false;
 		UEIENX = 1 << RXSTPE;                     // Enable interrupts for ep0
+		SetState(USB_STATE_ATTACHED);
+#ifdef USB_STATS_ENABLED
+		_usbStats.resets++;
+#endif
 	}
 
 	// Start of Frame
 	if (udint & (1<<SOFI))
 	{
-#ifdef CDC_ENABLED
-		USB_Flush(CDC_TX);            // Send a tx frame if found
-		while (USB_Available(CDC_RX)) // Handle received bytes (if any)
-			Serial_accept();
-#endif
+		for (USBClass* c = _classes; c; c = c->next)
+			if (c->sof)
+				c->sof(c);
 
 		// happens every millisecond so we use it for TX and RX LED one-shot timing, too
 		if (TxLEDPulse && !(--TxLEDPulse)) TXLED0;
@@ -510,8 +795,12 @@ int USB_Recv(u8 ep, void* d, int len)
 	u8* dst = (u8*)d;
 	while (n--)
 		*dst++ = Recv8();
+	USB_COUNT(ep, bytes, (u8) len);
 	if (len && !FifoByteCount())	// release empty buffer
+	{
 		ReleaseRX();
+		USB_COUNT(ep, packets, 1);
+	}
 	UNLOCKEP;
 
 	return len;
@@ -541,7 +830,14 @@ int USB_Send(u8 ep, const void* d, int len)
 		if (n == 0)
 		{
 			if (!(--timeout))
+			{
+#ifdef USB_STATS_ENABLED
+				LOCKEP;
+				USB_COUNT(ep, timeouts, 1);
+				UNLOCKEP;
+#endif
 				return -1;
+			}
 			delay(1);
 			continue;
 		}
@@ -551,6 +847,7 @@ int USB_Send(u8 ep, const void* d, int len)
 		len -= n;
 		{
 			LOCKEP;
+			USB_COUNT(ep, bytes, n);
 			if (ep & TRANSFER_ZERO)
 			{
 				while (n--)
@@ -567,7 +864,10 @@ int USB_Send(u8 ep, const void* d, int len)
 					Send8(*data++);
 			}
 			if (!ReadWriteAllowed() || ((len == 0) && (ep & TRANSFER_RELEASE)))	// Release full buffer
+			{
 				ReleaseTX();
+				USB_COUNT(ep, packets, 1);
+			}
 			UNLOCKEP;
 		}
 	}
@@ -587,17 +887,63 @@ int USB_RecvControl(void* d, int len)
 	return len;
 }
 
-// VBUS or counting frames
-// Any frame counting?
+u16 USB_FrameNumber(void)
+{
+	return FrameNumber();
+}
+
 u8 USBConnected()
 {
-	u8 f = UDFNUML;
-	delay(3);
-	return f != UDFNUML;
+	return _state == USB_STATE_CONFIGURED;
+}
+
+u8 USB_state(void)
+{
+	return _state;
+}
+
+void USB_stateHandler(USBStateHandler handler)
+{
+	_stateHandler = handler;
+}
+
+void USB_sleep(void)
+{
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	cli();
+	if (_state == USB_STATE_SUSPENDED)
+	{
+		// no interrupt between sei and sleep: a resume cannot be missed
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+}
+
+bool USB_wakeup(void)
+{
+	u8 sreg = SREG;
+	cli();
+	bool ok = _state == USB_STATE_SUSPENDED && _remoteWakeup;
+	if (ok)
+	{
+		// the host answers with a resume, which wakes the device up
+		ClockOn();
+		UDCON |= 1<<RMWKUP;
+	}
+	SREG = sreg;
+	return ok;
 }
 
 void USB_attach()
 {
+	u8 sreg = SREG;
+	cli();
+	PlugBuiltins();
+	SREG = sreg;
+
 	_curConf = 0;
 	UHWCON = 0x01;                  // power internal reg
 	USBCON = (1<<USBE)|(1<<FRZCLK); // clock frozen, usb enabled
@@ -606,9 +952,10 @@ void USB_attach()
 
 	delay(1); // quickfix for MacOsX 10.7.3 magic baud reset bug
 
-	USBCON = ((1<<USBE)|(1<<OTGPADE)); // start USB clock
-	UDIEN = (1<<EORSTE)|(1<<SOFE);     // Enable interrupts for EOR (End of Reset) and SOF (start of frame)
-	UDCON = 0;                         // enable attach resistor
+	USBCON = ((1<<USBE)|(1<<OTGPADE)|(1<<VBUSTE)); // start USB clock, VBUS interrupt
+	UDIEN = (1<<EORSTE)|(1<<SOFE)|(1<<SUSPE);       // Enable interrupts for EOR (End of Reset), SOF (start of frame) and suspension
+	UDCON = 0;                                      // enable attach resistor
+	_state = USBSTA & (1<<VBUS) ? USB_STATE_ATTACHED : USB_STATE_DETACHED;
 
 	TX_RX_LED_INIT;
 }
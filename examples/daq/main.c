@@ -0,0 +1,15 @@
+#include <Arduino.h>
+#include <c_DAQ.h>
+
+// streams A0 as fast as the ADC allows with a 500 kHz ADC clock (~38 kS/s);
+// read it with tools/adcread
+void setup()
+{
+	ADC_begin(ADC_PRESCALER_32, ADC_REF_VCC);
+	DAQ_begin(ADC_channel(A0), 0);
+}
+
+void loop()
+{
+	DAQ_poll();
+}
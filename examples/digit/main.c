@@ -1,10 +1,11 @@
 #include <Arduino.h>
+#include <avr/pgmspace.h>
 
-uint8_t digits []={0xFC,0x60,0xDA,0xF2,0x66,0xB6,0xBE,0xE0,0xFE,0xF6};
+const uint8_t digits[] PROGMEM = {0xFC,0x60,0xDA,0xF2,0x66,0xB6,0xBE,0xE0,0xFE,0xF6};
 uint8_t  led2pin[]={9, 8, 7,10,11,12,13, 6};
 void displayDigit(int d)
 {
-	byte code = digits[d%10];
+	byte code = pgm_read_byte(&digits[d%10]);
 	for (int c = 7; c >= 0; c--)
 	{   
 		digitalWrite(led2pin[c], code%2 ? HIGH : LOW);
@@ -0,0 +1,36 @@
+#include <Arduino.h>
+#include <c_USB.h>
+
+// two serial ports (needs HID_DISABLED in core/c_USB.h): the first one is
+// a console that echoes what it gets and starts ('g') or stops ('s') the
+// stream, the second one streams a counter as fast as USB allows
+static CDCPort data;
+static uint8_t streaming;
+
+void setup()
+{
+	CDC_begin(&data);
+}
+
+void loop()
+{
+	int c = Serial_read();
+	if (c >= 0)
+	{
+		if (c == 'g')
+			streaming = 1;
+		else if (c == 's')
+			streaming = 0;
+		Serial_write((uint8_t) c);
+	}
+
+	// whole packets only, so that the console never waits behind the stream
+	static uint8_t counter;
+	if (streaming && CDC_connected(&data) && USB_SendSpace(CDC_PORT_TX(&data)) == 64)
+	{
+		uint8_t packet[64];
+		for (uint8_t i = 0; i < sizeof(packet); i++)
+			packet[i] = counter++;
+		CDC_write(&data, packet, sizeof(packet));
+	}
+}
@@ -0,0 +1,14 @@
+#include <Arduino.h>
+#include <c_Gateway.h>
+
+// forwards the stream of an SPI master (mode 0, SS on PB0) to the serial
+// port; the master polls SPI_SPACE, then sends SPI_STREAM frames
+void setup()
+{
+	Gateway_begin(0);
+}
+
+void loop()
+{
+	Gateway_poll();
+}
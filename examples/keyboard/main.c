@@ -0,0 +1,33 @@
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include <c_Keys.h>
+
+// USB keyboard: 2 x 3 key matrix, rows on pins 4 and 5, columns on pins
+// 7, 8 and 9 (a diode per key, cathode towards the row), and the LED lit
+// while a key is pressed
+#define LED 13
+
+static const uint8_t rows[]    = { 4, 5 };
+static const uint8_t columns[] = { 7, 8, 9 };
+
+static const uint8_t keymap[] PROGMEM =
+{
+	0x04, 0x05, 0x06, // a b c
+	0xE1, 0x2C, 0x28, // left shift, space, enter
+};
+
+static const KeyMatrix matrix =
+{
+	2, 3, rows, columns, keymap, 5, KEYS_EAGER, 0
+};
+
+void setup()
+{
+	pinMode(LED, OUTPUT);
+	Keys_begin(&matrix);
+}
+
+void loop()
+{
+	digitalWrite(LED, Keys_row(0) || Keys_row(1) ? HIGH : LOW);
+}
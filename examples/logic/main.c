@@ -0,0 +1,16 @@
+#include <Arduino.h>
+#include <c_Capture.h>
+
+// records port B at 100 kHz; decode with tools/la2vcd -r 100000
+const uint8_t ports[] = { PB };
+const uint8_t masks[] = { 0xFE }; // PB0 is the RX LED
+
+void setup()
+{
+	Capture_begin(ports, masks, 1, 100000, CAPTURE_TIMER);
+}
+
+void loop()
+{
+	Capture_poll();
+}
@@ -0,0 +1,31 @@
+#include <Arduino.h>
+#include <c_ADC.h>
+#include <c_USB.h>
+
+// USB microphone: streams A0 at AUDIO_RATE as a USB audio device (needs
+// AUDIO_ENABLED in core/c_USB.h); record it with "arecord -D hw:CARD=Leonardo"
+#define LENGTH 16
+
+static uint16_t a[LENGTH];
+static uint16_t b[LENGTH];
+
+void setup()
+{
+	ADC_begin(ADC_PRESCALER_64, ADC_REF_VCC);
+	ADC_stream(ADC_channel(A0), AUDIO_RATE, a, b, LENGTH);
+}
+
+void loop()
+{
+	uint16_t* samples = ADC_next(NULL);
+	if (!samples)
+		return;
+
+	// 10-bit unsigned to 16-bit signed
+	int16_t pcm[LENGTH];
+	for (uint8_t i = 0; i < LENGTH; i++)
+		pcm[i] = (int16_t) (((int16_t) samples[i] - 512) * 64);
+	ADC_release(samples);
+
+	Audio_write(pcm, LENGTH);
+}
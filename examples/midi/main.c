@@ -0,0 +1,41 @@
+#include <Arduino.h>
+#include <c_USB.h>
+
+// USB MIDI controller (needs MIDI_ENABLED in core/c_USB.h): a button
+// between pin 2 and ground plays middle C, and the LED shows whether the
+// host is playing a note
+#define BUTTON 2
+#define NOTE   60
+#define LED    13
+
+static uint8_t pressed;
+
+void setup()
+{
+	pinMode(BUTTON, INPUT_PULLUP);
+	pinMode(LED, OUTPUT);
+}
+
+void loop()
+{
+	uint8_t now = !digitalRead(BUTTON);
+	if (now != pressed)
+	{
+		pressed = now;
+		if (pressed)
+			MIDI_noteOn(0, NOTE, 100);
+		else
+			MIDI_noteOff(0, NOTE, 0);
+		delay(5); // debouncing
+	}
+
+	MIDIEvent e;
+	while (MIDI_receive(&e))
+	{
+		uint8_t status = e.data[0] & 0xF0;
+		if (status == 0x90 && e.data[2])
+			digitalWrite(LED, HIGH);
+		else if (status == 0x80 || status == 0x90)
+			digitalWrite(LED, LOW);
+	}
+}
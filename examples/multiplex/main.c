@@ -0,0 +1,19 @@
+#include <Arduino.h>
+#include <c_Display.h>
+
+//                          a  b  c  d   e   f   g DP
+const uint8_t segments[] = {9, 8, 7, 10, 11, 12, 13, 6};
+const uint8_t digits  [] = {2, 3, 4, 5};
+
+int16_t counter = 0;
+
+void setup()
+{
+	Display_begin(segments, digits, 4, DISPLAY_COMMON_CATHODE);
+}
+
+void loop()
+{
+	Display_print(counter++);
+	delay(100);
+}
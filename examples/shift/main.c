@@ -1,11 +1,12 @@
 #include <Arduino.h>
+#include <avr/pgmspace.h>
 
 //         g  f  e  d DP  c  b  a
 int map[]={1, 2, 3, 4, 0, 5, 6, 7};
-uint8_t digits[]={0xFC,0x60,0xDA,0xF2,0x66,0xB6,0xBE,0xE0,0xFE,0xF6,0x08};
+const uint8_t digits[] PROGMEM = {0xFC,0x60,0xDA,0xF2,0x66,0xB6,0xBE,0xE0,0xFE,0xF6,0x08};
 void displayDigit(int d)
 {
-	byte code = digits[d%11];
+	byte code = pgm_read_byte(&digits[d%11]);
 	for (int c = 7; c >= 0; c--)
 	{   
 		int bit = (code >> map[c]) & 0x1;
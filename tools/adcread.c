@@ -0,0 +1,166 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+// Reads the ADC stream sent by core/c_DAQ.c and writes the samples to the
+// standard output, one per line (or as raw 16-bit little endian values with
+// -b). Sample rate and lost packets are reported every second on stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+
+#define PACKET_SIZE 64
+#define MAGIC       0xA5
+#define SAMPLES     ((PACKET_SIZE - 2) / 2)
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-b] [-n samples] [-q] /dev/ttyACM0\n", name);
+	exit(1);
+}
+
+// a packet starts with the sequence number and the magic byte, and the
+// high byte of every 10-bit sample is at most 3
+static int isPacket(const unsigned char* p)
+{
+	if (p[1] != MAGIC)
+		return 0;
+	for (int i = 3; i < PACKET_SIZE; i += 2)
+		if (p[i] > 3)
+			return 0;
+	return 1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+	int binary = 0;
+	int quiet = 0;
+	long long limit = -1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "bn:q")) != -1)
+	{
+		switch (opt)
+		{
+		case 'b': binary = 1; break;
+		case 'n': limit = atoll(optarg); break;
+		case 'q': quiet = 1; break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	int fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+	if (fd < 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	// raw mode; opening the port already raised DTR, which starts the stream
+	struct termios tio;
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tio.c_cc[VMIN] = PACKET_SIZE;
+		tio.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+
+	static unsigned char buf[1 << 16];
+	size_t len = 0;
+	int synced = 0;
+	int last = -1;
+	long long total = 0;
+	long long samples = 0;
+	long long dropped = 0;
+	long long skipped = 0;
+	double start = now();
+
+	while (limit < 0 || total < limit)
+	{
+		ssize_t n = read(fd, buf + len, sizeof(buf) - len);
+		if (n <= 0)
+		{
+			if (n < 0)
+				perror("read");
+			break;
+		}
+		len += (size_t) n;
+
+		size_t pos = 0;
+		while (len - pos >= PACKET_SIZE)
+		{
+			const unsigned char* p = buf + pos;
+			if (!isPacket(p))
+			{
+				// lost the packet boundaries: slide until they are found
+				if (synced)
+					fprintf(stderr, "lost synchronization\n");
+				synced = 0;
+				skipped++;
+				pos++;
+				continue;
+			}
+			synced = 1;
+
+			if (last >= 0)
+				dropped += (p[0] - last - 1) & 0xFF;
+			last = p[0];
+
+			int count = SAMPLES;
+			if (limit >= 0 && total + count > limit)
+				count = (int) (limit - total);
+			if (binary)
+				fwrite(p + 2, 2, (size_t) count, stdout);
+			else
+				for (int i = 0; i < count; i++)
+					printf("%u\n", p[2 + 2 * i] | p[3 + 2 * i] << 8);
+			total += count;
+			samples += count;
+			pos += PACKET_SIZE;
+		}
+		memmove(buf, buf + pos, len - pos);
+		len -= pos;
+
+		double t = now();
+		if (!quiet && t - start >= 1.0)
+		{
+			fprintf(stderr, "%.0f samples/s, %lld packets lost, %lld bytes skipped\n",
+			        (double) samples / (t - start), dropped, skipped);
+			samples = 0;
+			start = t;
+		}
+	}
+
+	fflush(stdout);
+	close(fd);
+	return 0;
+}
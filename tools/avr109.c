@@ -0,0 +1,691 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+// Uploads an Intel HEX file through the AVR109 bootloader of the Leonardo
+// (Caterina), writing only the flash pages that changed.
+//
+// The board is reset into its bootloader by opening its port at 1200
+// bauds; the bootloader's port is then polled for (the first new
+// /dev/ttyACM*, or the same one coming back) instead of waiting a fixed
+// time. The flash under the program is read back (reading is much faster
+// than writing) and only the pages that differ are written, then verified.
+// The image last written to each board is also kept, by USB path, in
+// ~/.cache/avr109, to report changes made by other programs. -f writes
+// every page of the program without reading, -r reads the whole flash,
+// -n skips the reset (the port is already the bootloader's) and -t only
+// resets the board and prints the bootloader's port (for avrdude), dropping
+// the cache.
+//
+// -S starts a stand-in bootloader on a pseudo-terminal, whose flash is
+// kept in the given file, for testing:
+//
+//     avr109 -S flash.bin &
+//     avr109 -n -p /dev/pts/N program.hex
+
+#define _XOPEN_SOURCE 600 // posix_openpt()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/stat.h>
+
+#define PAGE_SIZE   128
+#define FLASH_SIZE  0x7000 // below the 4 KB bootloader
+#define PAGES       (FLASH_SIZE / PAGE_SIZE)
+#define TIMEOUT_MS  1000
+#define RESET_MS    8000   // for the bootloader's port to show up
+
+static volatile sig_atomic_t _stop;
+
+static void onSignal(int sig)
+{
+	(void) sig;
+	_stop = 1;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr,
+	        "usage: %s [-f|-r] [-n] [-p /dev/ttyACM0] program.hex\n"
+	        "       %s -t [-p /dev/ttyACM0]\n"
+	        "       %s -S flash.bin\n", name, name, name);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void sleepMs(int ms)
+{
+	struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+}
+
+static int openRaw(const char* path, speed_t speed)
+{
+	int fd = open(path, O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		return -1;
+	struct termios tio;
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		cfsetspeed(&tio, speed);
+		tio.c_cflag |= HUPCL; // DTR drops on close
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	return fd;
+}
+
+//==================================================================
+//                            HEX FILE
+//==================================================================
+
+static int hexByte(const char* s)
+{
+	unsigned v;
+	return sscanf(s, "%2x", &v) == 1 ? (int) v : -1;
+}
+
+// fills image (erased flash elsewhere); returns the end of the program
+static long readHex(const char* path, unsigned char* image)
+{
+	FILE* f = fopen(path, "r");
+	if (!f)
+	{
+		perror(path);
+		return -1;
+	}
+	memset(image, 0xFF, FLASH_SIZE);
+
+	char line[600];
+	long base = 0;
+	long end = 0;
+	int n = 0;
+	while (fgets(line, sizeof(line), f))
+	{
+		n++;
+		if (line[0] != ':')
+			continue;
+		int count = hexByte(line + 1);
+		int hi    = hexByte(line + 3);
+		int lo    = hexByte(line + 5);
+		int type  = hexByte(line + 7);
+		if (count < 0 || hi < 0 || lo < 0 || type < 0 || (int) strlen(line) < 11 + 2 * count)
+			goto bad;
+		unsigned char sum = (unsigned char) (count + hi + lo + type);
+		unsigned char data[256];
+		for (int i = 0; i <= count; i++)
+		{
+			int b = hexByte(line + 9 + 2 * i);
+			if (b < 0)
+				goto bad;
+			sum = (unsigned char) (sum + b);
+			if (i < count)
+				data[i] = (unsigned char) b;
+		}
+		if (sum)
+			goto bad;
+
+		if (type == 0x00)
+		{
+			long address = base + (hi << 8 | lo);
+			if (address + count > FLASH_SIZE)
+			{
+				fprintf(stderr, "%s:%d: beyond the application flash\n", path, n);
+				fclose(f);
+				return -1;
+			}
+			memcpy(image + address, data, (size_t) count);
+			if (address + count > end)
+				end = address + count;
+		}
+		else if (type == 0x01)
+			break;
+		else if (type == 0x02 && count == 2)
+			base = (long) (data[0] << 8 | data[1]) << 4;
+		else if (type == 0x04 && count == 2)
+			base = (long) (data[0] << 8 | data[1]) << 16;
+	}
+	fclose(f);
+	return end;
+
+bad:
+	fprintf(stderr, "%s:%d: invalid record\n", path, n);
+	fclose(f);
+	return -1;
+}
+
+//==================================================================
+//                       BOOTLOADER'S PORT
+//==================================================================
+
+typedef struct
+{
+	char   names[32][64];
+	size_t count;
+} Ports;
+
+static void listPorts(Ports* p)
+{
+	glob_t g;
+	p->count = 0;
+	if (glob("/dev/ttyACM*", 0, NULL, &g))
+		return;
+	for (size_t i = 0; i < g.gl_pathc && p->count < 32; i++)
+		snprintf(p->names[p->count++], sizeof(p->names[0]), "%s", g.gl_pathv[i]);
+	globfree(&g);
+}
+
+static int hasPort(const Ports* p, const char* name)
+{
+	for (size_t i = 0; i < p->count; i++)
+		if (!strcmp(p->names[i], name))
+			return 1;
+	return 0;
+}
+
+// opens the port at 1200 bauds and closes it, which makes the sketch
+// start the bootloader; then the bootloader's port is a new one or the
+// same one, once it has disappeared
+static int reset(const char* port, char* found, size_t size)
+{
+	Ports before;
+	listPorts(&before);
+
+	int fd = openRaw(port, B1200);
+	if (fd < 0)
+	{
+		perror(port);
+		return -1;
+	}
+	close(fd);
+
+	int gone = 0;
+	for (double end = now() + RESET_MS / 1000.0; now() < end; sleepMs(20))
+	{
+		Ports ports;
+		listPorts(&ports);
+		for (size_t i = 0; i < ports.count; i++)
+		{
+			const char* name = ports.names[i];
+			if (!hasPort(&before, name) || (gone && !strcmp(name, port)))
+			{
+				snprintf(found, size, "%s", name);
+				return 0;
+			}
+		}
+		if (!hasPort(&ports, port))
+			gone = 1;
+	}
+	fprintf(stderr, "no bootloader port after resetting %s\n", port);
+	return -1;
+}
+
+// udev may still be setting the permissions of a new port
+static int openBootloader(const char* port)
+{
+	for (double end = now() + 1; ; sleepMs(20))
+	{
+		int fd = openRaw(port, B57600);
+		if (fd >= 0 || now() > end)
+			return fd;
+	}
+}
+
+//==================================================================
+//                            PROTOCOL
+//==================================================================
+
+static int readAll(int fd, unsigned char* data, size_t size)
+{
+	size_t n = 0;
+	while (n < size)
+	{
+		struct pollfd p = { fd, POLLIN, 0 };
+		if (poll(&p, 1, TIMEOUT_MS) <= 0)
+			return -1;
+		ssize_t r = read(fd, data + n, size - n);
+		if (r <= 0)
+			return -1;
+		n += (size_t) r;
+	}
+	return 0;
+}
+
+static int writeAll(int fd, const unsigned char* data, size_t size)
+{
+	while (size)
+	{
+		ssize_t r = write(fd, data, size);
+		if (r <= 0)
+			return -1;
+		data += r;
+		size -= (size_t) r;
+	}
+	return 0;
+}
+
+// sends a command, then reads a reply of the given size
+static int command(int fd, const unsigned char* out, size_t outSize, unsigned char* in, size_t inSize)
+{
+	if (writeAll(fd, out, outSize) || readAll(fd, in, inSize))
+	{
+		fprintf(stderr, "no reply to '%c'\n", out[0]);
+		return -1;
+	}
+	return 0;
+}
+
+static int commandOk(int fd, const unsigned char* out, size_t outSize)
+{
+	unsigned char r;
+	if (command(fd, out, outSize, &r, 1))
+		return -1;
+	if (r != '\r')
+	{
+		fprintf(stderr, "'%c' refused\n", out[0]);
+		return -1;
+	}
+	return 0;
+}
+
+static int setAddress(int fd, long byteAddress)
+{
+	long word = byteAddress / 2;
+	unsigned char c[3] = { 'A', (unsigned char) (word >> 8), (unsigned char) word };
+	return commandOk(fd, c, sizeof(c));
+}
+
+static int writePage(int fd, long address, const unsigned char* data)
+{
+	unsigned char c[4 + PAGE_SIZE] = { 'B', PAGE_SIZE >> 8, PAGE_SIZE & 0xFF, 'F' };
+	memcpy(c + 4, data, PAGE_SIZE);
+	if (setAddress(fd, address))
+		return -1;
+	return commandOk(fd, c, sizeof(c));
+}
+
+static int readFlash(int fd, long address, unsigned char* data, long size)
+{
+	if (setAddress(fd, address))
+		return -1;
+	for (long n = 0; n < size; n += PAGE_SIZE)
+	{
+		unsigned char c[4] = { 'g', PAGE_SIZE >> 8, PAGE_SIZE & 0xFF, 'F' };
+		if (command(fd, c, sizeof(c), data + n, PAGE_SIZE))
+			return -1;
+	}
+	return 0;
+}
+
+//==================================================================
+//                             CACHE
+//==================================================================
+
+// ~/.cache/avr109/<USB path of the port>, e.g. 1-1.4, so that a board
+// keeps its cache whatever number its port gets
+static void cachePath(const char* port, char* path, size_t size)
+{
+	const char* tty = strrchr(port, '/') ? strrchr(port, '/') + 1 : port;
+	char link[256];
+	char target[256];
+	char key[256];
+	snprintf(link, sizeof(link), "/sys/class/tty/%s/device", tty);
+	ssize_t n = readlink(link, target, sizeof(target) - 1);
+	if (n > 0)
+	{
+		target[n] = 0;
+		snprintf(key, sizeof(key), "%s", strrchr(target, '/') ? strrchr(target, '/') + 1 : target);
+		char* colon = strchr(key, ':');
+		if (colon)
+			*colon = 0;
+	}
+	else
+	{
+		// not USB (a pseudo-terminal): the name of the port
+		snprintf(key, sizeof(key), "%s", strncmp(port, "/dev/", 5) ? port : port + 5);
+		for (char* c = key; *c; c++)
+			if (*c == '/')
+				*c = '-';
+	}
+
+	const char* xdg  = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	char dir[256];
+	if (xdg && *xdg)
+		snprintf(dir, sizeof(dir), "%s", xdg);
+	else
+		snprintf(dir, sizeof(dir), "%s/.cache", home ? home : "/tmp");
+	mkdir(dir, 0755);
+	strncat(dir, "/avr109", sizeof(dir) - strlen(dir) - 1);
+	mkdir(dir, 0755);
+	snprintf(path, size, "%s/%s", dir, key);
+}
+
+static int loadImage(const char* path, unsigned char* image)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return -1;
+	size_t n = fread(image, 1, FLASH_SIZE, f);
+	fclose(f);
+	return n == FLASH_SIZE ? 0 : -1;
+}
+
+static void saveImage(const char* path, const unsigned char* image)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f || fwrite(image, 1, FLASH_SIZE, f) != FLASH_SIZE)
+		perror(path);
+	if (f)
+		fclose(f);
+}
+
+//==================================================================
+//                             UPLOAD
+//==================================================================
+
+static int upload(int fd, const char* port, unsigned char* image, long end, int full, int readBack)
+{
+	unsigned char id[7];
+	unsigned char block[3];
+	if (command(fd, (const unsigned char*) "S", 1, id, sizeof(id)) ||
+	    command(fd, (const unsigned char*) "b", 1, block, sizeof(block)))
+		return 1;
+	if (block[0] != 'Y' || (block[1] << 8 | block[2]) < PAGE_SIZE)
+	{
+		fprintf(stderr, "the bootloader cannot write whole pages\n");
+		return 1;
+	}
+	printf("%.7s on %s\n", id, port);
+
+	// what the flash holds now: the program range is always read back, as
+	// avrdude, the IDE or another board may have changed it since the cache
+	// was written; the cache only tells that it happened
+	static unsigned char old[FLASH_SIZE];
+	char cache[520];
+	cachePath(port, cache, sizeof(cache));
+	int cached = loadImage(cache, old) == 0;
+	long range = (end + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+	if (readBack)
+		range = FLASH_SIZE;
+	if (!full)
+	{
+		static unsigned char flash[FLASH_SIZE];
+		if (readFlash(fd, 0, flash, range))
+			return 1;
+		if (cached && memcmp(flash, old, (size_t) range))
+			printf("the flash changed since the last upload from here\n");
+		memcpy(old, flash, (size_t) range);
+	}
+
+	// pages past the program are left as they are
+	if (cached || readBack)
+		memcpy(image + end, old + end, (size_t) (FLASH_SIZE - end));
+
+	// no cache until the pages are verified: a failed run must not leave
+	// one that does not match the flash
+	remove(cache);
+
+	double start = now();
+	static unsigned char written[PAGES];
+	int count = 0;
+	for (long a = 0; a < end; a += PAGE_SIZE)
+	{
+		written[a / PAGE_SIZE] = full || memcmp(old + a, image + a, PAGE_SIZE);
+		if (!written[a / PAGE_SIZE])
+			continue;
+		if (writePage(fd, a, image + a))
+			return 1;
+		count++;
+	}
+
+	// the pages written are read back
+	for (long a = 0; a < end; a += PAGE_SIZE)
+	{
+		unsigned char page[PAGE_SIZE];
+		if (!written[a / PAGE_SIZE])
+			continue;
+		if (readFlash(fd, a, page, PAGE_SIZE))
+			return 1;
+		if (memcmp(page, image + a, PAGE_SIZE))
+		{
+			fprintf(stderr, "verification failed at 0x%04lx\n", a);
+			return 1;
+		}
+	}
+	saveImage(cache, image);
+
+	unsigned char exitCommand = 'E';
+	commandOk(fd, &exitCommand, 1);
+	printf("%d of %ld pages written in %.2f s\n",
+	       count, (end + PAGE_SIZE - 1) / PAGE_SIZE, now() - start);
+	return 0;
+}
+
+//==================================================================
+//                     STAND-IN BOOTLOADER
+//==================================================================
+
+static int serve(const char* file)
+{
+	static unsigned char flash[FLASH_SIZE];
+	if (loadImage(file, flash))
+		memset(flash, 0xFF, FLASH_SIZE);
+
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) || unlockpt(master))
+	{
+		perror("pseudo-terminal");
+		return 1;
+	}
+	const char* name = ptsname(master);
+	// kept open, so that reading does not fail between clients
+	int slave = openRaw(name, B57600);
+	if (slave < 0)
+	{
+		perror(name);
+		return 1;
+	}
+	struct termios tio;
+	tcgetattr(master, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(master, TCSANOW, &tio);
+	printf("%s\n", name);
+	fflush(stdout);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	long address = 0; // bytes
+	int pages = 0;
+	int reads = 0;
+	unsigned char c;
+	while (!_stop)
+	{
+		if (readAll(master, &c, 1))
+			continue;
+		unsigned char arg[4];
+		unsigned char reply[PAGE_SIZE];
+		size_t replySize = 1;
+		reply[0] = '\r';
+
+		switch (c)
+		{
+		case 'S':
+			memcpy(reply, "CATERIN", 7);
+			replySize = 7;
+			break;
+		case 'V':
+			memcpy(reply, "10", 2);
+			replySize = 2;
+			break;
+		case 'p':
+			reply[0] = 'S';
+			break;
+		case 'a':
+			reply[0] = 'Y';
+			break;
+		case 'b':
+			reply[0] = 'Y';
+			reply[1] = PAGE_SIZE >> 8;
+			reply[2] = PAGE_SIZE & 0xFF;
+			replySize = 3;
+			break;
+		case 's':
+			reply[0] = 0x87;
+			reply[1] = 0x95;
+			reply[2] = 0x1E;
+			replySize = 3;
+			break;
+		case 'A':
+			if (readAll(master, arg, 2))
+				continue;
+			address = (long) (arg[0] << 8 | arg[1]) * 2;
+			break;
+		case 'e':
+			memset(flash, 0xFF, FLASH_SIZE);
+			break;
+		case 'B':
+		case 'g':
+		{
+			if (readAll(master, arg, 3))
+				continue;
+			long size = arg[0] << 8 | arg[1];
+			if (arg[2] != 'F' || size > PAGE_SIZE || address + size > FLASH_SIZE)
+			{
+				reply[0] = '?';
+				if (c == 'B' && size <= PAGE_SIZE)
+					readAll(master, reply + 1, (size_t) size);
+				break;
+			}
+			if (c == 'g')
+			{
+				memcpy(reply, flash + address, (size_t) size);
+				replySize = (size_t) size;
+				reads++;
+			}
+			else
+			{
+				unsigned char data[PAGE_SIZE];
+				if (readAll(master, data, (size_t) size))
+					continue;
+				// like Caterina: erases the page, then writes it
+				memset(flash + address / PAGE_SIZE * PAGE_SIZE, 0xFF, PAGE_SIZE);
+				memcpy(flash + address, data, (size_t) size);
+				sleepMs(8);
+				pages++;
+			}
+			address += size;
+			break;
+		}
+		case 'E':
+			_stop = 1;
+			break;
+		default:
+			reply[0] = '?';
+		}
+		writeAll(master, reply, replySize);
+	}
+
+	saveImage(file, flash);
+	sleepMs(100); // for the client to read the last reply
+	printf("%d pages written, %d read\n", pages, reads);
+	close(slave);
+	close(master);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* port = "/dev/ttyACM0";
+	const char* stand = NULL;
+	int full = 0;
+	int readBack = 0;
+	int noReset = 0;
+	int touchOnly = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "frntp:S:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f': full = 1; break;
+		case 'r': readBack = 1; break;
+		case 'n': noReset = 1; break;
+		case 't': touchOnly = 1; break;
+		case 'p': port = optarg; break;
+		case 'S': stand = optarg; break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if (stand)
+		return serve(stand);
+
+	char bootloader[64];
+	if (touchOnly)
+	{
+		if (optind != argc || reset(port, bootloader, sizeof(bootloader)))
+			return 1;
+		// another program writes the flash: the cache will not match
+		char cache[520];
+		cachePath(bootloader, cache, sizeof(cache));
+		remove(cache);
+		printf("%s\n", bootloader);
+		return 0;
+	}
+
+	if (optind != argc - 1)
+		usage(argv[0]);
+	static unsigned char image[FLASH_SIZE];
+	long end = readHex(argv[optind], image);
+	if (end < 0)
+		return 1;
+
+	if (noReset)
+		snprintf(bootloader, sizeof(bootloader), "%s", port);
+	else if (reset(port, bootloader, sizeof(bootloader)))
+		return 1;
+
+	int fd = openBootloader(bootloader);
+	if (fd < 0)
+	{
+		perror(bootloader);
+		return 1;
+	}
+	int r = upload(fd, bootloader, image, end, full, readBack);
+	close(fd);
+	return r;
+}
@@ -0,0 +1,366 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+// Host side of core/c_Frame.c: COBS frames ending with a zero byte, whose
+// last 2 (or 4 with -c 32) bytes are the CRC of the payload.
+//
+//   -e   encodes each line of the standard input (without its newline) as
+//        a frame on the standard output
+//   -d   decodes the frames of a file or serial port, one payload per line
+//        (in hexadecimal with -x); corrupt frames are reported on stderr
+//   -t   self-test: random payloads, encoded, corrupted and decoded
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#define MAX_PAYLOAD 4096
+
+static int _crc32; // CRC-32 instead of CRC-16/CCITT-FALSE
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-c 16|32] -e | -d [-x] file|/dev/ttyACM0 | -t\n", name);
+	exit(1);
+}
+
+//==================================================================
+//                              CRC
+//==================================================================
+
+static uint16_t crc16(uint16_t crc, const unsigned char* p, size_t n)
+{
+	while (n--)
+	{
+		crc ^= (uint16_t) (*p++ << 8);
+		for (int i = 0; i < 8; i++)
+			crc = (uint16_t) (crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+	}
+	return crc;
+}
+
+static uint32_t crc32(uint32_t crc, const unsigned char* p, size_t n)
+{
+	while (n--)
+	{
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++)
+			crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+	}
+	return crc;
+}
+
+static size_t crcSize(void)
+{
+	return _crc32 ? 4 : 2;
+}
+
+// appends the CRC of the n bytes of p; returns the new length
+static size_t appendCRC(unsigned char* p, size_t n)
+{
+	if (_crc32)
+	{
+		uint32_t c = ~crc32(0xFFFFFFFF, p, n);
+		for (int i = 0; i < 4; i++, c >>= 8)
+			p[n++] = (unsigned char) c;
+	}
+	else
+	{
+		uint16_t c = crc16(0xFFFF, p, n);
+		p[n++] = (unsigned char) (c >> 8);
+		p[n++] = (unsigned char) c;
+	}
+	return n;
+}
+
+static int checkCRC(const unsigned char* p, size_t n)
+{
+	if (n < crcSize())
+		return 0;
+	if (_crc32)
+		return crc32(0xFFFFFFFF, p, n) == 0xDEBB20E3;
+	return crc16(0xFFFF, p, n) == 0;
+}
+
+//==================================================================
+//                              COBS
+//==================================================================
+
+// encodes n bytes (payload and CRC) and the final zero; out must have room
+// for n + n / 254 + 2 bytes; returns the frame length
+static size_t encode(const unsigned char* in, size_t n, unsigned char* out)
+{
+	size_t o = 0;
+	size_t i = 0;
+	for (;;)
+	{
+		size_t run = 0;
+		while (run < 254 && i + run < n && in[i + run])
+			run++;
+		out[o++] = (unsigned char) (run + 1);
+		memcpy(out + o, in + i, run);
+		o += run;
+		i += run;
+		if (i == n)
+			break;
+		if (run < 254)
+			i++; // the zero
+	}
+	out[o++] = 0;
+	return o;
+}
+
+typedef struct
+{
+	unsigned char buffer[MAX_PAYLOAD + 4];
+	size_t        length;
+	int           remaining;
+	int           zero;
+	int           started;
+	int           discard;
+	unsigned long errors;
+} Decoder;
+
+static void restart(Decoder* d)
+{
+	d->length    = 0;
+	d->remaining = 0;
+	d->zero      = 0;
+	d->started   = 0;
+	d->discard   = 0;
+}
+
+static void put(Decoder* d, unsigned char c)
+{
+	if (d->length == sizeof(d->buffer))
+	{
+		d->discard = 1;
+		d->errors++;
+		return;
+	}
+	d->buffer[d->length++] = c;
+}
+
+// returns the payload length once a valid frame is complete, -1 otherwise
+static long decode(Decoder* d, unsigned char c)
+{
+	if (!c)
+	{
+		long r = -1;
+		if (d->discard || !d->started)
+			;
+		else if (d->remaining || !checkCRC(d->buffer, d->length))
+			d->errors++;
+		else
+			r = (long) (d->length - crcSize());
+		restart(d);
+		return r;
+	}
+	if (d->discard)
+		return -1;
+	d->started = 1;
+	if (d->remaining)
+	{
+		put(d, c);
+		d->remaining--;
+	}
+	else
+	{
+		if (d->zero)
+			put(d, 0);
+		d->zero      = c != 0xFF;
+		d->remaining = c - 1;
+	}
+	return -1;
+}
+
+//==================================================================
+//                             MODES
+//==================================================================
+
+static void encodeLines(void)
+{
+	static unsigned char payload[MAX_PAYLOAD + 4];
+	static unsigned char frame[MAX_PAYLOAD + MAX_PAYLOAD / 254 + 8];
+	char*  line = NULL;
+	size_t size = 0;
+	ssize_t n;
+	while ((n = getline(&line, &size, stdin)) >= 0)
+	{
+		if (n && line[n - 1] == '\n')
+			n--;
+		if (n > MAX_PAYLOAD)
+		{
+			fprintf(stderr, "line too long, skipped\n");
+			continue;
+		}
+		memcpy(payload, line, (size_t) n);
+		size_t len = appendCRC(payload, (size_t) n);
+		fwrite(frame, 1, encode(payload, len, frame), stdout);
+	}
+	free(line);
+}
+
+static int decodeFile(const char* path, int hex)
+{
+	int fd = open(path, O_RDONLY | O_NOCTTY);
+	if (fd < 0)
+	{
+		perror(path);
+		return 1;
+	}
+	struct termios tio;
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+
+	static Decoder d;
+	restart(&d);
+	unsigned long errors = 0;
+	unsigned char buf[4096];
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+	{
+		for (ssize_t i = 0; i < n; i++)
+		{
+			long len = decode(&d, buf[i]);
+			if (len >= 0)
+			{
+				if (hex)
+				{
+					for (long j = 0; j < len; j++)
+						printf("%02x", d.buffer[j]);
+					putchar('\n');
+				}
+				else
+				{
+					fwrite(d.buffer, 1, (size_t) len, stdout);
+					putchar('\n');
+				}
+				fflush(stdout);
+			}
+			if (d.errors != errors)
+			{
+				fprintf(stderr, "corrupt frame dropped\n");
+				errors = d.errors;
+			}
+		}
+	}
+	close(fd);
+	return 0;
+}
+
+// frames of random length and content, with zero runs; one in four gets a
+// byte changed; every intact frame must come out, and no corrupt one
+static int selfTest(void)
+{
+	static unsigned char payload[MAX_PAYLOAD + 4];
+	static unsigned char frame[MAX_PAYLOAD + MAX_PAYLOAD / 254 + 8];
+	static Decoder d;
+	restart(&d);
+	srand(1);
+
+	unsigned long sent = 0, corrupted = 0, received = 0, wrong = 0;
+	for (int k = 0; k < 20000; k++)
+	{
+		size_t n = (size_t) (rand() % 4 ? rand() % 300 : rand() % 1000);
+		for (size_t i = 0; i < n; i++)
+			payload[i] = (unsigned char) (rand() % 3 ? rand() : 0);
+		unsigned char copy[MAX_PAYLOAD];
+		memcpy(copy, payload, n);
+		size_t len = encode(payload, appendCRC(payload, n), frame);
+
+		int corrupt = rand() % 4 == 0;
+		if (corrupt)
+		{
+			size_t at = (size_t) rand() % len;
+			frame[at] = (unsigned char) (frame[at] + 1 + rand() % 255);
+			corrupted++;
+		}
+		else
+			sent++;
+
+		long got = -1;
+		for (size_t i = 0; i < len; i++)
+		{
+			long r = decode(&d, frame[i]);
+			if (r >= 0)
+			{
+				got = r;
+				received++;
+			}
+		}
+		if (!corrupt && (got != (long) n || memcmp(d.buffer, copy, n)))
+			wrong++;
+		// a corrupted delimiter merges this frame with the next one; end
+		// it so that the next frame is decoded
+		if (corrupt)
+			decode(&d, 0);
+	}
+	printf("%lu intact frames, %lu corrupted, %lu decoded, %lu wrong\n",
+	       sent, corrupted, received, wrong);
+	return received == sent && !wrong ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	int mode = 0;
+	int hex  = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:edxt")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c':
+			_crc32 = atoi(optarg) == 32;
+			break;
+		case 'e':
+		case 'd':
+		case 't':
+			mode = opt;
+			break;
+		case 'x':
+			hex = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	switch (mode)
+	{
+	case 'e':
+		encodeLines();
+		return 0;
+	case 'd':
+		if (optind != argc - 1)
+			usage(argv[0]);
+		return decodeFile(argv[optind], hex);
+	case 't':
+		return selfTest();
+	default:
+		usage(argv[0]);
+	}
+	return 1;
+}
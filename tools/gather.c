@@ -0,0 +1,701 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+// Reads the frames of core/c_Frame.c from any number of boards at once,
+// with one epoll loop, and appends them to one file per port (named after
+// it, e.g. ttyACM0.rec), stamped with the time they were read.
+//
+// The files are written through a memory mapping, grown 16 MB at a time
+// (-s) and truncated to their records on exit; they are appended to when
+// they exist. Each record is, little-endian:
+//
+//     8 bytes   nanoseconds since the epoch (CLOCK_REALTIME) of the read
+//               that completed the frame
+//     4 bytes   length of the payload
+//     n bytes   payload (without the CRC)
+//
+// a zero header marking the end when the program could not truncate the
+// file. With -r, the bytes are recorded as read, without decoding frames.
+// The rates are reported every second on stderr (-q to silence them).
+//
+//   -D   dumps a record file, one record per line
+//   -F   creates n pseudo-terminals standing in for boards, prints their
+//        names and streams frames of -l bytes into them (-n frames each),
+//        for testing:
+//
+//            gather -F 4 -n 100000 > ports &
+//            gather -o /tmp/rec $(cat ports)
+
+#define _GNU_SOURCE // mremap()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAX_PAYLOAD 4096
+#define READ_SIZE   (1 << 16)
+#define HEADER_SIZE 12
+#define MAX_EVENTS  64
+
+static int _crc32; // CRC-32 instead of CRC-16/CCITT-FALSE
+
+static volatile sig_atomic_t _stop;
+
+static void onSignal(int sig)
+{
+	(void) sig;
+	_stop = 1;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr,
+	        "usage: %s [-c 16|32] [-r] [-o directory] [-s MB] [-q] /dev/ttyACM0...\n"
+	        "       %s -D file.rec\n"
+	        "       %s [-c 16|32] -F count [-l length] [-n frames]\n", name, name, name);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static uint64_t timestamp(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static void setRaw(int fd)
+{
+	struct termios tio;
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+}
+
+//==================================================================
+//                          CRC AND COBS
+//==================================================================
+// as in tools/cobs.c
+
+static uint16_t crc16(uint16_t crc, const unsigned char* p, size_t n)
+{
+	while (n--)
+	{
+		crc ^= (uint16_t) (*p++ << 8);
+		for (int i = 0; i < 8; i++)
+			crc = (uint16_t) (crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+	}
+	return crc;
+}
+
+static uint32_t crc32(uint32_t crc, const unsigned char* p, size_t n)
+{
+	while (n--)
+	{
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++)
+			crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+	}
+	return crc;
+}
+
+static size_t crcSize(void)
+{
+	return _crc32 ? 4 : 2;
+}
+
+static size_t appendCRC(unsigned char* p, size_t n)
+{
+	if (_crc32)
+	{
+		uint32_t c = ~crc32(0xFFFFFFFF, p, n);
+		for (int i = 0; i < 4; i++, c >>= 8)
+			p[n++] = (unsigned char) c;
+	}
+	else
+	{
+		uint16_t c = crc16(0xFFFF, p, n);
+		p[n++] = (unsigned char) (c >> 8);
+		p[n++] = (unsigned char) c;
+	}
+	return n;
+}
+
+static int checkCRC(const unsigned char* p, size_t n)
+{
+	if (n < crcSize())
+		return 0;
+	if (_crc32)
+		return crc32(0xFFFFFFFF, p, n) == 0xDEBB20E3;
+	return crc16(0xFFFF, p, n) == 0;
+}
+
+static size_t encode(const unsigned char* in, size_t n, unsigned char* out)
+{
+	size_t o = 0;
+	size_t i = 0;
+	for (;;)
+	{
+		size_t run = 0;
+		while (run < 254 && i + run < n && in[i + run])
+			run++;
+		out[o++] = (unsigned char) (run + 1);
+		memcpy(out + o, in + i, run);
+		o += run;
+		i += run;
+		if (i == n)
+			break;
+		if (run < 254)
+			i++; // the zero
+	}
+	out[o++] = 0;
+	return o;
+}
+
+typedef struct
+{
+	unsigned char buffer[MAX_PAYLOAD + 4];
+	size_t        length;
+	int           remaining;
+	int           zero;
+	int           started;
+	int           discard;
+	unsigned long errors;
+} Decoder;
+
+static void restart(Decoder* d)
+{
+	d->length    = 0;
+	d->remaining = 0;
+	d->zero      = 0;
+	d->started   = 0;
+	d->discard   = 0;
+}
+
+static void put(Decoder* d, unsigned char c)
+{
+	if (d->length == sizeof(d->buffer))
+	{
+		d->discard = 1;
+		d->errors++;
+		return;
+	}
+	d->buffer[d->length++] = c;
+}
+
+static long decode(Decoder* d, unsigned char c)
+{
+	if (!c)
+	{
+		long r = -1;
+		if (d->discard || !d->started)
+			;
+		else if (d->remaining || !checkCRC(d->buffer, d->length))
+			d->errors++;
+		else
+			r = (long) (d->length - crcSize());
+		restart(d);
+		return r;
+	}
+	if (d->discard)
+		return -1;
+	d->started = 1;
+	if (d->remaining)
+	{
+		put(d, c);
+		d->remaining--;
+	}
+	else
+	{
+		if (d->zero)
+			put(d, 0);
+		d->zero      = c != 0xFF;
+		d->remaining = c - 1;
+	}
+	return -1;
+}
+
+//==================================================================
+//                          RECORD FILES
+//==================================================================
+
+typedef struct
+{
+	int            fd;
+	unsigned char* map;
+	size_t         size;  // mapped, and size of the file
+	size_t         end;   // of the records
+	size_t         grow;
+} Log;
+
+static void putLE(unsigned char* p, uint64_t v, int n)
+{
+	for (int i = 0; i < n; i++, v >>= 8)
+		p[i] = (unsigned char) v;
+}
+
+static uint64_t getLE(const unsigned char* p, int n)
+{
+	uint64_t v = 0;
+	for (int i = n - 1; i >= 0; i--)
+		v = v << 8 | p[i];
+	return v;
+}
+
+// end of the records of a mapped file: its size, or a zero header
+static size_t findEnd(const unsigned char* map, size_t size)
+{
+	size_t at = 0;
+	while (at + HEADER_SIZE <= size)
+	{
+		uint64_t time   = getLE(map + at, 8);
+		uint64_t length = getLE(map + at + 8, 4);
+		if (!time && !length)
+			break;
+		if (length > size - at - HEADER_SIZE)
+			break; // cut by a crash: dropped
+		at += HEADER_SIZE + (size_t) length;
+	}
+	return at;
+}
+
+static int openLog(Log* log, const char* path, size_t grow)
+{
+	log->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (log->fd < 0)
+	{
+		perror(path);
+		return -1;
+	}
+	struct stat st;
+	fstat(log->fd, &st);
+	log->grow = grow;
+	log->size = (size_t) st.st_size + grow;
+	if (ftruncate(log->fd, (off_t) log->size))
+	{
+		perror(path);
+		close(log->fd);
+		return -1;
+	}
+	log->map = mmap(NULL, log->size, PROT_READ | PROT_WRITE, MAP_SHARED, log->fd, 0);
+	if (log->map == MAP_FAILED)
+	{
+		perror(path);
+		close(log->fd);
+		return -1;
+	}
+	madvise(log->map, log->size, MADV_SEQUENTIAL);
+	log->end = findEnd(log->map, (size_t) st.st_size);
+	return 0;
+}
+
+static int append(Log* log, uint64_t time, const unsigned char* data, size_t length)
+{
+	size_t need = log->end + HEADER_SIZE + length + HEADER_SIZE; // and the end mark
+	if (need > log->size)
+	{
+		size_t size = log->size + (need - log->size + log->grow - 1) / log->grow * log->grow;
+		void* map = mremap(log->map, log->size, size, MREMAP_MAYMOVE);
+		if (ftruncate(log->fd, (off_t) size) || map == MAP_FAILED)
+		{
+			perror("growing a record file");
+			return -1;
+		}
+		log->map  = map;
+		log->size = size;
+	}
+	unsigned char* p = log->map + log->end;
+	memcpy(p + HEADER_SIZE, data, length);
+	putLE(p + 8, length, 4);
+	putLE(p, time, 8);
+	log->end += HEADER_SIZE + length;
+	return 0;
+}
+
+static void closeLog(Log* log)
+{
+	munmap(log->map, log->size);
+	if (ftruncate(log->fd, (off_t) log->end))
+		perror("truncating a record file");
+	close(log->fd);
+}
+
+static int dump(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st))
+	{
+		perror(path);
+		return 1;
+	}
+	size_t size = (size_t) st.st_size;
+	const unsigned char* map = size ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+	if (map == MAP_FAILED)
+	{
+		perror(path);
+		return 1;
+	}
+	size_t end = findEnd(map, size);
+	for (size_t at = 0; at < end; )
+	{
+		uint64_t time   = getLE(map + at, 8);
+		size_t   length = (size_t) getLE(map + at + 8, 4);
+		printf("%llu.%09llu %zu ", (unsigned long long) (time / 1000000000u),
+		       (unsigned long long) (time % 1000000000u), length);
+		for (size_t i = 0; i < length; i++)
+			printf("%02x", map[at + HEADER_SIZE + i]);
+		putchar('\n');
+		at += HEADER_SIZE + length;
+	}
+	if (size)
+		munmap((void*) map, size);
+	close(fd);
+	return 0;
+}
+
+//==================================================================
+//                            GATHERING
+//==================================================================
+
+typedef struct
+{
+	const char*   path;
+	char          name[64];
+	int           fd;
+	Log           log;
+	Decoder       decoder;
+	unsigned long long frames;
+	unsigned long long bytes;
+	unsigned long long framesSecond; // since the last report
+	unsigned long long bytesSecond;
+} Device;
+
+// ttyACM0 for /dev/ttyACM0, pts-3 for /dev/pts/3
+static void deviceName(const char* path, char* name, size_t size)
+{
+	snprintf(name, size, "%s", strncmp(path, "/dev/", 5) ? path : path + 5);
+	for (char* c = name; *c; c++)
+		if (*c == '/')
+			*c = '-';
+}
+
+// reads everything there is; returns -1 once the port is gone
+static int readDevice(Device* d, int raw)
+{
+	static unsigned char buf[READ_SIZE];
+	for (;;)
+	{
+		ssize_t n = read(d->fd, buf, sizeof(buf));
+		if (n < 0 && errno == EAGAIN)
+			return 0;
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+
+		uint64_t time = timestamp();
+		d->bytes += (size_t) n;
+		d->bytesSecond += (size_t) n;
+		if (raw)
+		{
+			if (append(&d->log, time, buf, (size_t) n))
+				return -1;
+			d->frames++;
+			d->framesSecond++;
+		}
+		else
+		{
+			for (ssize_t i = 0; i < n; i++)
+			{
+				long length = decode(&d->decoder, buf[i]);
+				if (length < 0)
+					continue;
+				if (append(&d->log, time, d->decoder.buffer, (size_t) length))
+					return -1;
+				d->frames++;
+				d->framesSecond++;
+			}
+		}
+		if ((size_t) n < sizeof(buf))
+			return 0;
+	}
+}
+
+static int gather(char** paths, int count, const char* directory, size_t grow, int raw, int quiet)
+{
+	int ep = epoll_create1(0);
+	Device* devices = calloc((size_t) count, sizeof(Device));
+	if (ep < 0 || !devices)
+	{
+		perror("epoll");
+		return 1;
+	}
+
+	int open_ = 0;
+	for (int i = 0; i < count; i++)
+	{
+		Device* d = &devices[i];
+		d->path = paths[i];
+		d->fd = -1;
+		deviceName(d->path, d->name, sizeof(d->name));
+		restart(&d->decoder);
+
+		char file[512];
+		snprintf(file, sizeof(file), "%s/%s.rec", directory, d->name);
+		int fd = open(d->path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+		if (fd < 0)
+		{
+			perror(d->path);
+			continue;
+		}
+		if (openLog(&d->log, file, grow))
+		{
+			close(fd);
+			continue;
+		}
+		// raw mode; opening the port raised DTR, which starts the streams
+		setRaw(fd);
+		struct epoll_event ev = { .events = EPOLLIN, .data.ptr = d };
+		epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+		d->fd = fd;
+		open_++;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	double start = now();
+	while (open_ && !_stop)
+	{
+		struct epoll_event events[MAX_EVENTS];
+		int n = epoll_wait(ep, events, MAX_EVENTS, 1000);
+		for (int i = 0; i < n; i++)
+		{
+			Device* d = events[i].data.ptr;
+			if (readDevice(d, raw) == 0 && !(events[i].events & (EPOLLHUP | EPOLLERR)))
+				continue;
+			fprintf(stderr, "%s: closed\n", d->name);
+			epoll_ctl(ep, EPOLL_CTL_DEL, d->fd, NULL);
+			close(d->fd);
+			closeLog(&d->log);
+			d->fd = -1;
+			open_--;
+		}
+
+		double t = now();
+		if (!quiet && t - start >= 1.0)
+		{
+			unsigned long long frames = 0, bytes = 0, errors = 0;
+			for (int i = 0; i < count; i++)
+			{
+				frames += devices[i].framesSecond;
+				bytes  += devices[i].bytesSecond;
+				errors += devices[i].decoder.errors;
+				devices[i].framesSecond = devices[i].bytesSecond = 0;
+			}
+			fprintf(stderr, "%d ports, %.0f %s/s, %.0f KB/s, %llu corrupt frames\n",
+			        open_, (double) frames / (t - start), raw ? "reads" : "frames",
+			        (double) bytes / (t - start) / 1024, errors);
+			start = t;
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		Device* d = &devices[i];
+		if (d->fd >= 0)
+		{
+			close(d->fd);
+			closeLog(&d->log);
+		}
+		if (!quiet)
+			fprintf(stderr, "%s: %llu %s, %llu bytes, %lu corrupt frames\n", d->name,
+			        d->frames, raw ? "reads" : "frames", d->bytes, d->decoder.errors);
+	}
+	free(devices);
+	close(ep);
+	return 0;
+}
+
+//==================================================================
+//                          FAKE BOARDS
+//==================================================================
+
+typedef struct
+{
+	int           master;
+	int           slave;    // kept open, so that the master does not hang up
+	int           index;
+	unsigned long sent;     // frames
+	unsigned char buf[READ_SIZE];
+	size_t        length;
+	size_t        pos;
+} Fake;
+
+// frames carrying the index of the port and their number, with zeros
+static void refill(Fake* f, size_t length, unsigned long limit)
+{
+	unsigned char payload[MAX_PAYLOAD + 4];
+	f->length = f->pos = 0;
+	while (f->length + length + length / 254 + 8 <= sizeof(f->buf) && (!limit || f->sent < limit))
+	{
+		putLE(payload, (uint64_t) f->index, 4);
+		putLE(payload + 4, f->sent, 4);
+		for (size_t i = 8; i < length; i++)
+			payload[i] = (unsigned char) (f->sent + i) % 8 ? (unsigned char) (f->sent * i) : 0;
+		f->length += encode(payload, appendCRC(payload, length), f->buf + f->length);
+		f->sent++;
+	}
+}
+
+static int fake(int count, size_t length, unsigned long limit)
+{
+	int ep = epoll_create1(0);
+	Fake* fakes = calloc((size_t) count, sizeof(Fake));
+	if (ep < 0 || !fakes)
+	{
+		perror("epoll");
+		return 1;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		Fake* f = &fakes[i];
+		f->index = i;
+		f->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+		if (f->master < 0 || grantpt(f->master) || unlockpt(f->master))
+		{
+			perror("pseudo-terminal");
+			return 1;
+		}
+		// raw, before anything is written: no echo, no translation
+		setRaw(f->master);
+		f->slave = open(ptsname(f->master), O_RDWR | O_NOCTTY);
+		printf("%s\n", ptsname(f->master));
+		struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = f };
+		epoll_ctl(ep, EPOLL_CTL_ADD, f->master, &ev);
+	}
+	fflush(stdout);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	int active = count;
+	while (active && !_stop)
+	{
+		struct epoll_event events[MAX_EVENTS];
+		int n = epoll_wait(ep, events, MAX_EVENTS, 1000);
+		for (int i = 0; i < n; i++)
+		{
+			Fake* f = events[i].data.ptr;
+			if (f->pos == f->length)
+				refill(f, length, limit);
+			if (f->pos == f->length)
+			{
+				epoll_ctl(ep, EPOLL_CTL_DEL, f->master, NULL);
+				active--;
+				continue;
+			}
+			ssize_t w = write(f->master, f->buf + f->pos, f->length - f->pos);
+			if (w > 0)
+				f->pos += (size_t) w;
+		}
+	}
+
+	// lets the readers empty the terminals, then hangs them up
+	sleep(1);
+	for (int i = 0; i < count; i++)
+	{
+		fprintf(stderr, "%s: %lu frames\n", ptsname(fakes[i].master), fakes[i].sent);
+		close(fakes[i].slave);
+		close(fakes[i].master);
+	}
+	free(fakes);
+	close(ep);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* directory = ".";
+	size_t grow = 16;
+	int raw = 0;
+	int quiet = 0;
+	int fakes = 0;
+	size_t length = 60;
+	unsigned long limit = 0;
+	const char* dumped = NULL;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "c:ro:s:qD:F:l:n:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c': _crc32 = atoi(optarg) == 32; break;
+		case 'r': raw = 1; break;
+		case 'o': directory = optarg; break;
+		case 's': grow = (size_t) atol(optarg); break;
+		case 'q': quiet = 1; break;
+		case 'D': dumped = optarg; break;
+		case 'F': fakes = atoi(optarg); break;
+		case 'l': length = (size_t) atol(optarg); break;
+		case 'n': limit = (unsigned long) atol(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if (dumped)
+		return dump(dumped);
+	if (fakes > 0)
+	{
+		if (length < 8 || length > MAX_PAYLOAD)
+		{
+			fprintf(stderr, "the length must be between 8 and %d\n", MAX_PAYLOAD);
+			return 1;
+		}
+		return fake(fakes, length, limit);
+	}
+	if (optind == argc || !grow)
+		usage(argv[0]);
+	return gather(argv + optind, argc - optind, directory, grow << 20, raw, quiet);
+}
@@ -0,0 +1,191 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+// Decodes the logic analyzer stream of core/c_Capture.c (from the serial
+// port or a file it was saved to) into a VCD file, viewable with GTKWave.
+// The tick rate is the one returned by Capture_rate() on the board.
+// Reading a port stops on end of file or Ctrl+C.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+static volatile sig_atomic_t _stop;
+
+static void onSignal(int sig)
+{
+	(void) sig;
+	_stop = 1;
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s -r ticks_per_second [-o output.vcd] /dev/ttyACM0|capture.bin\n", name);
+	exit(1);
+}
+
+typedef struct
+{
+	FILE*              out;
+	unsigned long long rate;
+	unsigned long long ticks;  // time of the next record
+	unsigned long long lost;
+	int                ports;  // 0 until the first packet
+	int                values; // last written values (-1: none yet)
+} VCD;
+
+static unsigned long long nanoseconds(const VCD* v)
+{
+	return v->ticks / v->rate * 1000000000ULL + v->ticks % v->rate * 1000000000ULL / v->rate;
+}
+
+static void header(VCD* v, int ports)
+{
+	v->ports = ports;
+	fprintf(v->out, "$timescale 1 ns $end\n$scope module capture $end\n");
+	for (int i = 0; i < 8 * ports; i++)
+		fprintf(v->out, "$var wire 1 %c p%d_%d $end\n", '!' + i, i / 8, i % 8);
+	fprintf(v->out, "$upscope $end\n$enddefinitions $end\n");
+}
+
+static void record(VCD* v, int values, int run)
+{
+	if (values != v->values)
+	{
+		fprintf(v->out, "#%llu\n", nanoseconds(v));
+		for (int i = 0; i < 8 * v->ports; i++)
+		{
+			int bit = (values >> i) & 1;
+			if (v->values < 0 || ((v->values >> i) & 1) != bit)
+				fprintf(v->out, "%d%c\n", bit, '!' + i);
+		}
+		v->values = values;
+	}
+	v->ticks += (unsigned long long) run;
+}
+
+// returns the number of bytes used, 0 if the packet is incomplete
+static size_t packet(VCD* v, const unsigned char* p, size_t len)
+{
+	if (len < 2)
+		return 0;
+	size_t n = p[1] & 0x3F;
+	if (len < 2 + n)
+		return 0;
+
+	int ports = (p[1] & 0x40) ? 2 : 1;
+	if (!v->ports)
+		header(v, ports);
+	if (p[1] & 0x80)
+	{
+		// the time base is broken from here on
+		fprintf(v->out, "$comment records lost $end\n");
+		v->lost++;
+	}
+
+	size_t size = (size_t) ports + 1;
+	for (size_t i = 0; i + size <= n; i += size)
+	{
+		const unsigned char* r = p + 2 + i;
+		int values = ports == 2 ? r[0] | r[1] << 8 : r[0];
+		record(v, values, r[size - 1]);
+	}
+	return 2 + n;
+}
+
+int main(int argc, char** argv)
+{
+	VCD v = { stdout, 0, 0, 0, 0, -1 };
+
+	int opt;
+	while ((opt = getopt(argc, argv, "r:o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r':
+			v.rate = strtoull(optarg, NULL, 10);
+			break;
+		case 'o':
+			v.out = fopen(optarg, "w");
+			if (!v.out)
+			{
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || v.rate == 0)
+		usage(argv[0]);
+
+	int fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+	if (fd < 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	struct termios tio;
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	static unsigned char buf[1 << 16];
+	size_t len = 0;
+	int seq = -1;
+	while (!_stop)
+	{
+		ssize_t n = read(fd, buf + len, sizeof(buf) - len);
+		if (n <= 0)
+			break;
+		len += (size_t) n;
+
+		size_t pos = 0;
+		size_t used;
+		while ((used = packet(&v, buf + pos, len - pos)))
+		{
+			if (seq >= 0 && buf[pos] != ((seq + 1) & 0xFF))
+				fprintf(stderr, "packet %d follows %d\n", buf[pos], seq);
+			seq = buf[pos];
+			pos += used;
+		}
+		memmove(buf, buf + pos, len - pos);
+		len -= pos;
+	}
+
+	if (v.ports)
+		fprintf(v.out, "#%llu\n", nanoseconds(&v));
+	if (v.lost)
+		fprintf(stderr, "%llu packets follow lost records\n", v.lost);
+	fclose(v.out);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*\
+ *  Library for pure-C programming for Arduino
+ *  Copyright (C) 2012  Quentin SANTOS
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+\*/
+
+
+// Reads the USB counters of a board built with USB_STATS_ENABLED (see
+// USBStats in core/c_USB.h) through the vendor request, and prints them.
+// The board is found in sysfs by its vendor and product identifiers
+// (2341:8036 by default); -c clears the counters after reading them, -i
+// repeats every given number of seconds. Needs write access to the USB
+// device node (/dev/bus/usb/...).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+#define STATS_REQUEST  0x5A
+#define ENDPOINTS      7
+#define ENDPOINT_SIZE  12
+#define STATS_SIZE     (ENDPOINTS * ENDPOINT_SIZE + 4)
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [-d vid:pid] [-c] [-i seconds]\n", name);
+	exit(1);
+}
+
+static unsigned readHex(const char* dir, const char* file)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	FILE* f = fopen(path, "r");
+	if (!f)
+		return 0;
+	unsigned v = 0;
+	if (fscanf(f, "%x", &v) != 1)
+		v = 0;
+	fclose(f);
+	return v;
+}
+
+static unsigned readDec(const char* dir, const char* file)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	FILE* f = fopen(path, "r");
+	if (!f)
+		return 0;
+	unsigned v = 0;
+	if (fscanf(f, "%u", &v) != 1)
+		v = 0;
+	fclose(f);
+	return v;
+}
+
+// opens the first device with these identifiers
+static int openDevice(unsigned vid, unsigned pid)
+{
+	glob_t g;
+	if (glob("/sys/bus/usb/devices/*/idVendor", 0, NULL, &g))
+		return -1;
+	int fd = -1;
+	for (size_t i = 0; i < g.gl_pathc && fd < 0; i++)
+	{
+		char* dir = g.gl_pathv[i];
+		*strrchr(dir, '/') = 0;
+		if (readHex(dir, "idVendor") != vid || readHex(dir, "idProduct") != pid)
+			continue;
+		char node[64];
+		snprintf(node, sizeof(node), "/dev/bus/usb/%03u/%03u",
+		         readDec(dir, "busnum"), readDec(dir, "devnum"));
+		fd = open(node, O_RDWR);
+		if (fd < 0)
+			perror(node);
+	}
+	globfree(&g);
+	return fd;
+}
+
+static unsigned u16le(const unsigned char* p)
+{
+	return (unsigned) (p[0] | p[1] << 8);
+}
+
+static unsigned long u32le(const unsigned char* p)
+{
+	return (unsigned long) u16le(p) | (unsigned long) u16le(p + 2) << 16;
+}
+
+static int readStats(int fd, int clear)
+{
+	unsigned char s[STATS_SIZE];
+	struct usbdevfs_ctrltransfer t =
+	{
+		.bRequestType = 0xC0, // device to host, vendor, device
+		.bRequest     = STATS_REQUEST,
+		.wValue       = (unsigned short) clear,
+		.wIndex       = 0,
+		.wLength      = sizeof(s),
+		.timeout      = 1000,
+		.data         = s,
+	};
+	int n = ioctl(fd, USBDEVFS_CONTROL, &t);
+	if (n != (int) sizeof(s))
+	{
+		fprintf(stderr, n < 0 ? "request failed (USB_STATS_ENABLED?)\n" : "short reply\n");
+		return 1;
+	}
+
+	printf("EP        bytes  packets timeouts  flushes overflows\n");
+	for (int ep = 1; ep < ENDPOINTS; ep++)
+	{
+		const unsigned char* e = s + ep * ENDPOINT_SIZE;
+		printf("%2d %12lu %8u %8u %8u %9u\n", ep, u32le(e),
+		       u16le(e + 4), u16le(e + 6), u16le(e + 8), u16le(e + 10));
+	}
+	const unsigned char* g = s + ENDPOINTS * ENDPOINT_SIZE;
+	printf("stalls %u, bus resets %u\n", u16le(g), u16le(g + 2));
+	fflush(stdout);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned vid = 0x2341;
+	unsigned pid = 0x8036;
+	int clear = 0;
+	int interval = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "d:ci:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': if (sscanf(optarg, "%x:%x", &vid, &pid) != 2) usage(argv[0]); break;
+		case 'c': clear = 1; break;
+		case 'i': interval = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc)
+		usage(argv[0]);
+
+	int fd = openDevice(vid, pid);
+	if (fd < 0)
+	{
+		fprintf(stderr, "no device %04x:%04x\n", vid, pid);
+		return 1;
+	}
+
+	int r;
+	while (!(r = readStats(fd, clear)) && interval > 0)
+	{
+		sleep((unsigned) interval);
+		putchar('\n');
+	}
+	close(fd);
+	return r;
+}